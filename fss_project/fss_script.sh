@@ -2,11 +2,14 @@
 
 #script for listing sync directories and cleaning up
 
+#read-only status tool of a running manager (reads shared memory, no log parsing needed)
+FSS_STATUS="$(dirname "$0")/bin/fss_status"
+
 #show all sync operations from the log file
 show_list_all() {
     echo ">>> Full sync list:"
     while IFS= read -r line; do
-        if echo "$line" | grep -qE "\[(FULL|ADDED|MODIFIED|DELETED)\]"; then
+        if echo "$line" | grep -qE "\[(FULL|MIRROR|BATCH|ADDED|MODIFIED|DELETED)\]"; then
             ts=$(echo "$line" | awk -F'[][]' '{print $2}')
             src=$(echo "$line" | awk -F'[][]' '{print $4}')
             trg=$(echo "$line" | awk -F'[][]' '{print $6}')
@@ -17,9 +20,12 @@ show_list_all() {
 }
 
 
-#show currently monitored directories from the log 
+#show currently monitored directories, live from a running manager or else from the log 
 show_monitored() {
     echo ">>> Currently monitored directories:"
+    if [ -x "$FSS_STATUS" ] && "$FSS_STATUS" -a 2>/dev/null; then
+        return
+    fi
     grep "\[ADD\] New pair:" "$1" | while IFS= read -r line; do
         ts=$(echo "$line" | awk -F'[][]' '{print $2}')
         src=$(echo "$line" | sed -n 's/.*New pair: \([^ ]*\) -> .*/\1/p')
@@ -33,6 +39,9 @@ show_monitored() {
 #show directrories that are no longer monitored 
 show_stopped() {
     echo ">>> Directories no longer monitored:"
+    if [ -x "$FSS_STATUS" ] && "$FSS_STATUS" -i 2>/dev/null; then
+        return
+    fi
     grep "\[CANCEL\]" "$1" | while IFS= read -r line; do
         #extract timestamp and directory name 
         ts=$(echo "$line" | awk -F'[][]' '{print $2}')
@@ -0,0 +1,17 @@
+#ifndef AUTOSCALE_H
+#define AUTOSCALE_H
+
+#define AUTOSCALE_WINDOW_MS 1000  //length of one measurement window 
+#define AUTOSCALE_MAX_STRETCH 10  //a window without finished workers is extended up to this many times 
+#define AUTOSCALE_START 2  //concurrency used before any measurement 
+#define AUTOSCALE_GAIN 1.10  //a raise must improve throughput by 10% to be kept 
+#define AUTOSCALE_IOWAIT_HIGH 0.40  //share of cpu time in I/O wait that counts as a saturated disk 
+#define AUTOSCALE_HOLD 5  //windows to wait before trying to raise again after a back off 
+
+
+void autoscale_init(int ceiling); //sets the -n ceiling and the starting concurrency 
+int autoscale_limit(); //current number of workers allowed to run at once 
+void autoscale_record(long long bytes, long files); //accounts the work of a finished worker 
+void autoscale_tick(int queued, int running); //re-evaluates the limit once per window 
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef FANOTIFY_UTILS_H
+#define FANOTIFY_UTILS_H
+
+#include "monitor.h"
+
+
+extern monitor_backend fanotify_backend; //fanotify implementation of the monitor interface (one mark per filesystem)
+
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#define FILTER_SPEC_LEN 1024  //room for the option text of one pair 
+
+#define FILTER_LITERAL 0  //exact name, e.g. "Thumbs.db"
+#define FILTER_SUFFIX 1  //"*" followed by a literal, e.g. "*.swp"
+#define FILTER_PREFIX 2  //a literal followed by "*", e.g. "tmp_*"
+#define FILTER_GLOB 3  //anything else, matched with fnmatch 
+
+
+//one compiled include or exclude rule 
+typedef struct{
+    int kind;
+    int exclude;
+    char *text;  //literal part (the whole pattern for globs)
+    int length;
+}filter_rule;
+
+
+//the compiled rules of one pair 
+typedef struct{
+    filter_rule *rules;
+    int count;
+    int includes;  //number of include rules; with any, names must match one of them 
+    unsigned char last_chars[32];  //prefilter: bitmap of the last characters an exclude rule can match 
+    int any_last;  //an exclude rule can end with any character 
+    char spec[FILTER_SPEC_LEN];  //"include=... exclude=..." text handed to the workers 
+}filter_set;
+
+
+void filter_init(filter_set *set); //prepares an empty set 
+int filter_add(filter_set *set, const char *pattern, int exclude); //compiles one rule (returns -1 on error)
+int filter_parse(filter_set *set, const char *spec); //compiles every include=/exclude= token of a spec (returns -1 on an unknown token)
+int filter_excluded(const filter_set *set, const char *name); //returns 1 if a name must not be synchronized 
+void filter_free(filter_set *set); //releases the rules and empties the set 
+
+#endif
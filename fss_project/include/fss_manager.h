@@ -5,9 +5,22 @@
 #include <limits.h>
 #include <signal.h>
 
-#define MAX_PAIRS 100  //maximum number of source-target diretcory pairs
-#define MAX_QUEUE 100  //maximum number of queued synchronization tasks
-#define MAX_WORKERS 5
+#define MAX_PAIRS 1024  //maximum number of watched source directories
+#define MAX_TARGETS 16  //maximum number of targets replicated from one source, also the most a worker accepts 
+#define MAX_QUEUE 1024  //maximum number of queued synchronization tasks
+#define MAX_WORKERS 5  //default ceiling for concurrent workers (-n)
+#define MAX_RUNNING_WORKERS 64  //highest ceiling accepted for -n 
+#define INITIAL_SYNC_WAVE 8  //initial full syncs queued at a time after startup 
+#define WATCH_BATCH 64  //sources of loaded pairs registered with the monitor per main loop iteration 
+#define DEFAULT_EVENT_TIMEOUT 300  //seconds an event run may take before it is killed 
+#define DEFAULT_FULL_TIMEOUT 86400  //seconds a full sync, snapshot or verify slice may take 
+#define BATCH_TIMEOUT_PER_FILE_MS 50  //extra time a batch run gets for each file in its list 
+#define KILL_GRACE_MS 5000  //time between SIGTERM and SIGKILL for a worker past its deadline 
+#define MAX_RETRIES 1024  //failed tasks waiting for another attempt 
+#define RETRY_LIMIT 6  //attempts after the first run before a task is given up 
+#define RETRY_BASE_MS 2000  //delay before the first retry, doubled for each further attempt 
+#define RETRY_MAX_MS 300000  //longest delay between attempts, also used for degraded pairs 
+#define VERIFY_STATE_FILE "fss_verify.state"  //progress of running verifies, so they resume after a restart 
 #define PIPE_IN "fss_in"
 #define PIPE_OUT "fss_out"
 #define CONFIG_FILE "config.txt"
@@ -29,6 +42,11 @@ typedef struct{
 typedef struct{
     char src_path[PATH_MAX];
     char trg_path[PATH_MAX];
+    char filename[NAME_MAX + 1];  //"ALL" for full syncs
+    char operation[16];  //FULL, MIRROR, ADDED, MODIFIED or DELETED
+    unsigned long trace_id;  //follows the task through the queue, the worker and the report 
+    long long queued_us;  //when the task entered the queue 
+    int attempt;  //retries of this task so far (0 for fresh work)
 }worker_task;
 
 
@@ -36,11 +54,22 @@ extern int q_start;
 extern int q_end;
 extern int active_workers;
 extern int out_fd;
+extern long global_bw_limit;  //bytes per second shared by all background syncs (0 = unlimited)
+extern long global_file_limit;  //files per second shared by all background syncs (0 = unlimited)
+extern long global_parallel_threshold;  //file size from which workers copy with several threads (0 = worker default)
+extern int global_copy_threads;  //threads per large file copy (0 = worker default)
+extern long global_bulk_threshold;  //file size from which workers copy around the page cache (0 = never, -1 = worker default)
+extern int startup_wave;  //initial full syncs queued per wave 
+extern long global_event_timeout;  //deadline of an event run in seconds (0 = none)
+extern long global_full_timeout;  //deadline of a full sync, snapshot or verify slice in seconds (0 = none)
+extern long global_scrub_bw_limit;  //bytes per second of each verify run (0 = only the normal limits)
 extern int pair_total;  //total number of monitored pairs
 extern sync_pair pair_list[MAX_PAIRS];
 extern worker_task workers_queue[MAX_QUEUE];
 extern FILE *manager_log_file;
 extern volatile sig_atomic_t worker_done;
+extern volatile sig_atomic_t reload_requested;  //set by SIGHUP 
+extern char config_file_path[PATH_MAX];
 
 
 #endif
\ No newline at end of file
@@ -0,0 +1,29 @@
+#ifndef FSZ_CODEC_H
+#define FSZ_CODEC_H
+
+#define FSZ_MAGIC "FSZ1"
+#define FSZ_VERSION 1
+#define FSZ_HEADER_SIZE 32  //magic, version, flags, original size, source mtime and mode
+#define FSZ_BLOCK_SIZE 65536  //raw bytes per block, matches the worker read buffer
+#define FSZ_BLOCK_HEADER 8  //raw length and stored length of a block
+#define FSZ_RAW_FLAG 0x80000000u  //stored length flag: the block is kept uncompressed
+#define FSZ_BOUND(size) (FSZ_BLOCK_HEADER + (size))  //room for one framed block, a block that does not shrink is stored raw
+
+
+//metadata of the source file, stored at the start of a compressed file
+typedef struct{
+    unsigned long long size;
+    long long mtime_sec;
+    long mtime_nsec;
+    unsigned int mode;
+}fsz_header;
+
+
+void fsz_write_header(char *buffer, const fsz_header *header); //encodes a header into FSZ_HEADER_SIZE bytes
+int fsz_read_header(const char *buffer, fsz_header *header); //decodes a header (returns -1 if the buffer is not a compressed file)
+int fsz_compress_block(const char *src, int size, char *dst, int capacity); //LZ77 compresses one block (returns its length, 0 if it does not shrink)
+int fsz_decompress_block(const char *src, int size, char *dst, int capacity); //expands one block (returns the raw length, -1 if it is corrupt)
+int fsz_write_block(const char *raw, int size, char *out); //frames one block, compressed or raw, into FSZ_BOUND(size) bytes (returns the framed length)
+int fsz_block_info(const char *buffer, int *raw_size, int *stored_size, int *is_raw); //decodes a block header (returns -1 if it is invalid)
+
+#endif
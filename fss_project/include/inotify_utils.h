@@ -3,6 +3,7 @@
 
 #include <limits.h>
 #include "fss_manager.h"
+#include "monitor.h"
 
 #define EVENT_BUF_LEN (1024 * (sizeof(struct inotify_event) + NAME_MAX + 1))
 
@@ -18,8 +19,13 @@ extern watch_entry watch_table[MAX_PAIRS]; //all active watches
 extern int watch_count; //number of active watches
 
 
-void init_inotify(); //initializes the inotify instance 
+extern monitor_backend inotify_backend; //inotify implementation of the monitor interface
+
+
+int init_inotify(); //initializes the inotify instance (returns -1 on failure)
 void add_watch(const char *src); //adds a new directroy to be watched 
+void add_watches(const char **srcs, int count); //adds several directories to be watched at once 
+void remove_watch(const char *src); //stops watching a directory 
 void handle_inotify_events(); //handles inotify events and triggers appropriate synchronization
 
 
@@ -1,12 +1,33 @@
 #ifndef MANAGER_UTILS_H
 #include <stdarg.h>
+#include <poll.h>
 #define MANAGER_UTILS_H
 
+int apply_global_options(const char *options); //applies throttling and copy options from a "global" config line 
 void load_config(const char *filename); //loads synchronization pairs from the config file into memory 
+int reload_config(const char *filename, int *added, int *removed, int *kept); //applies the difference between the config file and the registry 
+int register_pending_watches(); //adds the next batch of watches for loaded pairs (returns 1 while more are waiting)
+int schedule_initial_syncs(); //queues the next wave of initial full syncs (returns 1 while more are waiting)
 void handle_command(const char *cmd, int out_fd); //processes a command received from fss_console and sends a response 
 void queue_sync_task(const char *source_path, const char *target_path); //adds a new synchronization task into the workers queue
+void queue_snapshot_task(const char *source_path, const char *target_path); //adds a snapshot task into the workers queue 
+void queue_verify_task(const char *source_path); //adds the next verify slice of a source into the workers queue 
+int schedule_periodic_tasks(); //queues the scheduled snapshots and scrubs that are due (returns ms until the next one, -1 if none)
+void save_verify_state(); //writes the progress of running verifies to VERIFY_STATE_FILE 
+void load_verify_state(); //resumes the verifies recorded in VERIFY_STATE_FILE 
+unsigned long queue_event_task(const char *source_path, const char *target_path, const char *filename, const char *operation); //adds a single file event into the workers queue (target_path NULL means every target) and returns its trace id 
 void dispatch_workers(int output_fd); //starts new worker processes for pending tasks, respecting the worker limit 
+int worker_poll_fds(struct pollfd *fds, int max); //adds the report pipes of the running workers to a poll set 
+void handle_worker_output(struct pollfd *fds, int count); //reads worker reports and applies the finished ones 
+void wait_running_workers(); //waits for every running worker to finish 
+int workers_busy(); //returns 1 while tasks are queued or workers are running 
+int check_worker_deadlines(); //terminates workers past their deadline (returns ms until the next deadline, -1 if none)
+int next_retry_ms(); //returns ms until the next failed task is retried (-1 if none is waiting)
+int open_status_table(); //creates the shared memory status table (returns -1 on error)
+void close_status_table(); //removes the shared memory status table 
+int publish_status(); //refreshes the shared status table (returns ms until a deferred refresh is due, -1 if current)
 void child_signal_handler(int signal_number); //signal handler for SIGCHLD to detect when workers finish 
+void reload_signal_handler(int signal_number); //signal handler for SIGHUP to request a config reload 
 
 void log_msg(const char *message); //logs a simple message to the manager log file
 void log_and_print(const char *format, ...); //logs a formatted message to both the screen and manager log file
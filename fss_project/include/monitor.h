@@ -0,0 +1,29 @@
+#ifndef MONITOR_H
+#define MONITOR_H
+
+
+//a filesystem monitoring backend (inotify or fanotify)
+typedef struct{
+    const char *name;
+    int (*init)(void);  //returns 0 on success, -1 if the backend is not available 
+    void (*add_watch)(const char *src);  //starts reporting changes of a source directory 
+    void (*add_watches)(const char **srcs, int count);  //same for several sources, logged as one batch 
+    void (*remove_watch)(const char *src);  //stops reporting changes of a source directory 
+    void (*handle_events)(void);  //reads pending events and feeds them to monitor_event()
+    int (*get_fd)(void);  //descriptor to poll for pending events 
+}monitor_backend;
+
+
+extern monitor_backend *monitor;  //the selected backend
+
+
+int init_monitor(const char *backend_name); //selects and initializes a backend, falling back to inotify 
+void monitor_fall_back(const char *src); //replaces an unusable fanotify backend by inotify and watches the active sources and src there 
+void monitor_add_watch(const char *src); //adds a source directory to the selected backend 
+void monitor_add_watches(const char **srcs, int count); //adds a batch of source directories to the selected backend 
+void monitor_remove_watch(const char *src); //removes a source directory from the selected backend 
+void monitor_event(const char *src, const char *filename, const char *type); //queues a change of a monitored source for the workers 
+void monitor_overflow(); //queues a full sync of every source after lost events 
+
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef STATUS_SHM_H
+#define STATUS_SHM_H
+
+#include <sys/types.h>
+
+#define STATUS_SHM_NAME "/fss_status"  //shared memory object published by fss_manager
+#define STATUS_MAGIC 0x46535354  //"FSST"
+#define STATUS_VERSION 3
+#define STATUS_MAX_ENTRIES 4096  //published (source, target) pairs
+#define STATUS_PATH_LEN 256  //same limit as the config file and console paths
+#define STATUS_FILTER_LEN 1024  //same as FILTER_SPEC_LEN
+#define STATUS_PUBLISH_MS 100  //the manager refreshes the table at most this often
+
+
+//state of one (source, target) pair as shown by status
+//seq is odd while the manager rewrites the entry; readers retry until they copied an even, unchanged seq
+typedef struct{
+    unsigned int seq;
+    char src[STATUS_PATH_LEN];
+    char trg[STATUS_PATH_LEN];
+    char last_sync[64];
+    char result[32];
+    int errors;
+    int failures;  //failed runs since the last success
+    int active;
+    int syncing;
+    int degraded;
+    int mirror;
+    int queued;  //tasks of the source waiting in the queue
+    int running;  //a worker of the source is running
+    long bw_limit;
+    long file_limit;
+    long snapshot_interval;
+    char last_snapshot[64];
+    char snapshot_result[32];
+    int verify_running;
+    int verify_deep;
+    int verify_done;
+    int verify_total;
+    int verify_mismatches;
+    char last_verify[64];
+    long scrub_interval;
+    char filters[STATUS_FILTER_LEN];
+    char dedup[8];  //"clone", "link" or empty 
+    long dedup_files;
+    long long dedup_bytes;  //bytes the dedup store saved since the manager started 
+    int compress;
+    long long compress_raw;  //source bytes compressed since the manager started 
+    long long compress_stored;
+}status_entry;
+
+
+//header fields copied out under the seqlock
+typedef struct{
+    pid_t manager_pid;
+    long long updated;
+    int count;
+    int dropped;
+    int queue_depth;
+    int running_workers;
+    int worker_limit;
+}status_summary;
+
+
+//the whole table; the summary has its own seqlock
+typedef struct{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int seq;
+    status_summary summary;
+    status_entry entries[STATUS_MAX_ENTRIES];
+}status_table;
+
+
+status_table *status_create(); //creates the shared table for writing, replacing an old one (NULL on error)
+void status_destroy(status_table *table); //unmaps and removes the shared table
+void status_write_entry(status_table *table, int slot, const status_entry *entry); //publishes one entry if it changed
+void status_write_summary(status_table *table, const status_summary *summary); //publishes the header fields
+const status_table *status_attach(); //maps the table of a running manager read-only (NULL if there is none)
+void status_detach(const status_table *table); //unmaps a table mapped with status_attach
+void status_read_entry(const status_table *table, int slot, status_entry *entry); //copies a consistent snapshot of one entry
+void status_read_summary(const status_table *table, status_summary *summary); //copies a consistent snapshot of the header
+int status_format_entry(const status_entry *entry, char *buffer, size_t size); //formats the status block of one target (returns its length)
+int status_find(const status_table *table, const char *src, int from, status_entry *entry); //finds the next entry of a source from slot from (returns its slot, -1 if none)
+
+#endif
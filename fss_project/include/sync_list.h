@@ -4,6 +4,12 @@
 #include <limits.h>
 #include <stdio.h>
 #include <time.h>
+#include "fss_manager.h"
+#include "filter.h"
+#include "status_shm.h"
+
+#define SYNC_HASH_SIZE 4096  //buckets of the source path lookup table 
+#define DEGRADED_AFTER 5  //consecutive failed runs that put a target in the degraded state 
 
 typedef struct sync_node{
     char src[PATH_MAX];
@@ -12,18 +18,66 @@ typedef struct sync_node{
     int active;
     int syncing; 
     int errors;
+    int failures;  //failed runs since the last success 
+    int degraded;  //kept failing, retries wait the longest delay until a run succeeds again 
+    int mirror;  //prune target files that no longer exist in source 
+    long bw_limit;  //background sync bytes per second (0 = unlimited)
+    long file_limit;  //background sync files per second (0 = unlimited)
+    char ioprio[8];  //io class for background syncs: "idle", "be" or empty 
     char result[32];
+    int initial_pending;  //initial full sync not scheduled yet 
+    int watch_pending;  //source not registered with the monitor yet, the initial full sync waits for it 
+    int seen;  //present in the config file during a reload 
+    long snapshot_interval;  //seconds between scheduled snapshots (0 = on request only)
+    time_t next_snapshot;  //when the next scheduled snapshot is due 
+    char last_snapshot[64];
+    char snapshot_result[32];
+    filter_set filter;  //include/exclude rules of the pair 
+    char dedup[8];  //share identical files through the store of the target filesystem: "clone", "link" or empty 
+    char dedup_store[PATH_MAX];  //store directory of the pair, empty to use the one found on the target filesystem 
+    long dedup_files;  //files taken from the store instead of being copied 
+    long long dedup_bytes;  //bytes those files did not have to write 
+    int compress;  //cold replica: files are stored compressed 
+    long long compress_raw;  //source bytes compressed into the target 
+    long long compress_stored;  //bytes written for them 
+    int verify_running;  //a verify of the source is in progress (same on every target of the source)
+    int verify_deep;  //compare content hashes, not only size and mtime 
+    int verify_done;  //files checked so far 
+    int verify_total;  //files in the source at the last slice 
+    int verify_mismatches;  //differences found on this target by the current or last verify 
+    char verify_cursor[NAME_MAX + 1];  //last name checked, the next slice starts after it 
+    char last_verify[64];
+    long scrub_interval;  //seconds between scheduled deep verifies (0 = on request only)
+    time_t next_scrub;
+    int status_slot;  //entry in the shared status table (-1 until published)
+    int queued;  //tasks of the source in the queue, counted when the status table is published 
+    int running;  //a worker of the source is running, same update 
     struct sync_node *next;
+    struct sync_node *hash_next;  //next node in the same lookup bucket 
 
 }sync_node;
 
 extern sync_node *sync_list;
 
-int add_sync_pair(const char *src, const char *trg); //adds a new sync pair to the sync list 
+int add_sync_pair(const char *src, const char *trg); //adds a new sync pair (or a new target of an existing source) to the sync list 
 sync_node *find_sync_pair(const char *src); //finds a sync pair by source directory path
+sync_node *next_sync_target(sync_node *pair); //returns the next target of the same source, or NULL 
+sync_node *find_sync_target(const char *src, const char *trg); //finds the pair of a specific source and target
+sync_node *find_active_pair(const char *src); //finds an active target of a source directory 
+int source_degraded(const char *src, const char *trg); //checks whether a target (or any target if trg is empty) of a source is degraded 
+int collect_targets(const char *src, const char *only_trg, char *list, size_t list_size, char *mirror_mask, size_t mask_size); //joins the active targets of a source with ':' (returns their count)
+int update_target_status(const char *src, const char *trg, const char *status, int full_sync); //records the result of a worker run for one target (returns 1 if it became degraded, -1 if it recovered)
 void print_status(const char *src, int fd); //prints the status of a specific sync pair to a file descriptor 
+void fill_status_entry(const sync_node *pair, status_entry *entry); //copies the state of a pair into a status table entry 
 void free_sync_list(); //frees all nodes from the sync list 
 int start_manual_sync(const char *src, char *trg_out); //starts a manual sync for a specific source directory 
-int cancel_sync_pair(const char *src); //cancels the monitoring of a specific source directory 
+int cancel_sync_pair(const char *src); //cancels the monitoring of a specific source directory and all its targets 
+int start_verify(const char *src, int deep); //marks a verify of every target of a source as running (0 if not monitored, -1 if already running)
+void stop_verify(const char *src); //clears the running verify of every target of a source (after a slice was given up)
+long parse_rate(const char *text); //parses a rate with an optional K/M/G suffix (returns -1 on error)
+long parse_interval(const char *text); //parses a duration in seconds with an optional m/h/d suffix (returns -1 on error)
+int update_snapshot_status(const char *src, const char *trg, const char *status); //records the result of a snapshot for one target (returns 1 if it became degraded, -1 if it recovered)
+void reset_pair_options(sync_node *pair); //restores the default per-pair options 
+int apply_pair_options(sync_node *pair, const char *options); //applies per-pair options (e.g. "mirror") from a config line or add command 
 
 #endif
\ No newline at end of file
@@ -0,0 +1,15 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#define TRACE_MAX_SPANS 16384  //spans kept in memory, older ones are overwritten 
+#define TRACE_LABEL_LEN 128
+
+
+long long trace_now_us(); //monotonic clock in microseconds, shared by the manager and the workers 
+unsigned long trace_new_id(); //returns a new trace id for a task 
+void trace_monitor_read(); //marks the start of a read from the monitor backend 
+long long trace_read_started(); //returns the start of the current monitor read 
+void trace_span(unsigned long id, const char *stage, long long start_us, long long end_us, const char *label); //records one stage of a task 
+int trace_dump(const char *path); //writes the recorded spans as Chrome trace-event JSON (returns the span count, -1 on error)
+
+#endif
@@ -0,0 +1,130 @@
+#include "../include/autoscale.h"
+#include "../include/fss_manager.h"
+#include <stdio.h>
+#include <time.h>
+
+
+//hill climbing on measured throughput: raise the limit while the queue backs up and each raise pays off,
+//step back when a raise brought no gain or the disks spend their time in I/O wait 
+static int ceiling = 1;
+static int limit = 1;
+static long long window_bytes = 0;
+static long window_files = 0;
+static struct timespec window_start;
+static double last_byte_rate = 0;
+static double last_file_rate = 0;
+static int raised = 0;  //the limit was raised at the end of the previous window 
+static int hold = 0;
+static unsigned long long last_iowait = 0;
+static unsigned long long last_total = 0;
+
+
+//read the aggregate iowait and total cpu time from /proc/stat (returns -1 if unavailable)
+static int read_cpu_times(unsigned long long *iowait, unsigned long long *total){
+
+    FILE *stat_file = fopen("/proc/stat", "r");
+    if(!stat_file){
+        return -1;
+    }
+    unsigned long long user, nice, system, idle, io, irq, softirq, steal;
+    int fields = fscanf(stat_file, "cpu %llu %llu %llu %llu %llu %llu %llu %llu", &user, &nice, &system, &idle, &io, &irq, &softirq, &steal);
+    fclose(stat_file);
+    if(fields != 8){
+        return -1;
+    }
+    *iowait = io;
+    *total = user + nice + system + idle + io + irq + softirq + steal;
+    return 0;
+}
+
+
+//share of cpu time spent in I/O wait since the previous call 
+static double iowait_share(){
+
+    unsigned long long iowait, total;
+    if(read_cpu_times(&iowait, &total) != 0){
+        return 0;
+    }
+    double share = 0;
+    if(last_total > 0 && total > last_total){
+        share = (double)(iowait - last_iowait) / (total - last_total);
+    }
+    last_iowait = iowait;
+    last_total = total;
+    return share;
+}
+
+
+//set the ceiling given with -n and start below it 
+void autoscale_init(int max){
+    ceiling = max < 1 ? 1 : max;
+    limit = AUTOSCALE_START < ceiling ? AUTOSCALE_START : ceiling;
+    clock_gettime(CLOCK_MONOTONIC, &window_start);
+    iowait_share();
+}
+
+
+int autoscale_limit(){
+    return limit;
+}
+
+
+//add the bytes and files of a finished worker to the current window 
+void autoscale_record(long long bytes, long files){
+    window_bytes += bytes;
+    window_files += files;
+}
+
+
+//close the window once it is long enough and adjust the limit 
+void autoscale_tick(int queued, int running){
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double elapsed = (now.tv_sec - window_start.tv_sec) + (now.tv_nsec - window_start.tv_nsec) / 1e9;
+    if(elapsed * 1000 < AUTOSCALE_WINDOW_MS){
+        return;
+    }
+    //long runs report only when they finish: stretch the window until something completes 
+    int busy = (queued > 0 || running > 0);
+    if(busy && window_bytes == 0 && window_files == 0 && elapsed * 1000 < AUTOSCALE_WINDOW_MS * AUTOSCALE_MAX_STRETCH){
+        return;
+    }
+
+    double byte_rate = window_bytes / elapsed;
+    double file_rate = window_files / elapsed;
+    double iowait = iowait_share();
+    int old = limit;
+    const char *reason = NULL;
+
+    if(busy && iowait > AUTOSCALE_IOWAIT_HIGH && limit > 1){
+        limit--;
+        hold = AUTOSCALE_HOLD;
+        reason = "high I/O wait";
+    } else if(busy && raised && byte_rate <= last_byte_rate * AUTOSCALE_GAIN && file_rate <= last_file_rate * AUTOSCALE_GAIN){
+        //the extra worker did not pay off 
+        limit--;
+        hold = AUTOSCALE_HOLD;
+        reason = "no throughput gain";
+    } else if(hold > 0){
+        hold--;
+    } else if(queued > 0 && running >= limit && limit < ceiling){
+        limit++;
+        reason = "queue backlog";
+    }
+    raised = (limit > old);
+
+    if(reason){
+        fprintf(manager_log_file, "[AUTOSCALE] Workers %d -> %d (%s, %.1f MB/s, %.1f files/s, iowait %.0f%%)\n", old, limit, reason, byte_rate / (1024 * 1024), file_rate, iowait * 100);
+        fflush(manager_log_file);
+    }
+
+    //idle windows carry no measurement, keep the last busy one as reference 
+    if(busy || window_bytes > 0 || window_files > 0){
+        last_byte_rate = byte_rate;
+        last_file_rate = file_rate;
+    }
+    window_bytes = 0;
+    window_files = 0;
+    window_start = now;
+}
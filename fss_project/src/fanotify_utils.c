@@ -0,0 +1,242 @@
+#define _GNU_SOURCE
+#include "../include/fanotify_utils.h"
+#include "../include/fss_manager.h"
+#include "../include/manager_utils.h"
+#include "../include/trace.h"
+#include <sys/fanotify.h>
+#include <sys/statfs.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+
+#define MAX_HANDLE_BYTES 128
+#define MAX_FILESYSTEMS 32
+#define FANOTIFY_BUF_LEN 65536
+#define FANOTIFY_EVENTS (FAN_CREATE | FAN_MODIFY | FAN_DELETE)
+
+
+//a monitored source directory identified by its file handle, so events need no path resolution 
+typedef struct{
+    char src[PATH_MAX];
+    fsid_t fsid;
+    int handle_type;
+    unsigned int handle_bytes;
+    unsigned char handle[MAX_HANDLE_BYTES];
+}fanotify_source;
+
+
+static int fanotify_fd = -1;
+static fanotify_source source_table[MAX_PAIRS];
+static int source_count = 0;
+static fsid_t marked_fs[MAX_FILESYSTEMS];  //filesystems that already carry our mark 
+static int marked_count = 0;
+
+
+//create the fanotify group reporting directory handle and name of each change 
+static int init_fanotify(){
+    fanotify_fd = fanotify_init(FAN_CLASS_NOTIF | FAN_REPORT_DFID_NAME | FAN_NONBLOCK | FAN_CLOEXEC, O_RDONLY);
+    if(fanotify_fd < 0){
+        perror("fanotify_init");
+        return -1;
+    }
+
+    //since Linux 5.13 the group is created without CAP_SYS_ADMIN but filesystem marks are refused, 
+    //so one is added and removed again to find out whether the backend can work at all 
+    if(fanotify_mark(fanotify_fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, FANOTIFY_EVENTS, AT_FDCWD, ".") == -1){
+        if(errno == EPERM){
+            perror("fanotify_mark");
+            close(fanotify_fd);
+            fanotify_fd = -1;
+            return -1;
+        }
+    } else{
+        fanotify_mark(fanotify_fd, FAN_MARK_REMOVE | FAN_MARK_FILESYSTEM, FANOTIFY_EVENTS, AT_FDCWD, ".");
+    }
+    return 0;
+}
+
+
+//descriptor polled by the manager for fanotify events 
+static int fanotify_get_fd(){
+    return fanotify_fd;
+}
+
+
+//register a source directory without logging it; the filesystem holding it is marked only once 
+//(returns 1 if added, 0 if already registered, -1 on error)
+static int watch_source(const char *src){
+
+    for(int i = 0; i < source_count; i++){
+        if(strcmp(source_table[i].src, src) == 0){
+            return 0;
+        }
+    }
+
+    if(source_count >= MAX_PAIRS){
+        fprintf(stderr, "Watch limit reached.\n");
+        return -1;
+    }
+
+    struct statfs fs;
+    if(statfs(src, &fs) == -1){
+        fprintf(stderr, "Could not watch %s (%s)\n", src, strerror(errno));
+        return -1;
+    }
+
+    //remember the directory handle the kernel will report for its children 
+    struct{
+        struct file_handle fh;
+        unsigned char bytes[MAX_HANDLE_BYTES];
+    }handle;
+    int mount_id;
+    handle.fh.handle_bytes = MAX_HANDLE_BYTES;
+    if(name_to_handle_at(AT_FDCWD, src, &handle.fh, &mount_id, 0) == -1){
+        fprintf(stderr, "Could not get handle of %s (%s)\n", src, strerror(errno));
+        return -1;
+    }
+
+    int marked = 0;
+    for(int i = 0; i < marked_count; i++){
+        if(memcmp(&marked_fs[i], &fs.f_fsid, sizeof(fsid_t)) == 0){
+            marked = 1;
+            break;
+        }
+    }
+    if(!marked){
+        if(marked_count >= MAX_FILESYSTEMS || fanotify_mark(fanotify_fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, FANOTIFY_EVENTS, AT_FDCWD, src) == -1){
+            fprintf(stderr, "Could not mark filesystem of %s (%s)\n", src, strerror(errno));
+            //marks that are not permitted at all will fail for every source: hand them to inotify 
+            if(errno == EPERM && marked_count == 0){
+                close(fanotify_fd);
+                fanotify_fd = -1;
+                source_count = 0;
+                monitor_fall_back(src);
+            }
+            return -1;
+        }
+        marked_fs[marked_count++] = fs.f_fsid;
+        log_and_print("[WATCH] Marking filesystem of: %s", src);
+    }
+
+    fanotify_source *entry = &source_table[source_count++];
+    strncpy(entry->src, src, PATH_MAX - 1);
+    entry->src[PATH_MAX - 1] = '\0';
+    entry->fsid = fs.f_fsid;
+    entry->handle_type = handle.fh.handle_type;
+    entry->handle_bytes = handle.fh.handle_bytes;
+    memcpy(entry->handle, handle.fh.f_handle, handle.fh.handle_bytes);
+    return 1;
+}
+
+
+//register a source directory 
+static void fanotify_add_watch(const char *src){
+    if(watch_source(src) == 1){
+        log_and_print("[WATCH] Adding watch to: %s", src);
+    }
+}
+
+
+//register several source directories, logging one line for the whole batch 
+static void fanotify_add_watches(const char **srcs, int count){
+    int added = 0;
+    for(int i = 0; i < count; i++){
+        if(watch_source(srcs[i]) == 1){
+            added++;
+        }
+        //marks turned out not to be permitted: the rest of the batch goes to inotify 
+        if(monitor != &fanotify_backend){
+            if(i + 1 < count){
+                monitor_add_watches(srcs + i + 1, count - i - 1);
+            }
+            return;
+        }
+    }
+    log_and_print("[WATCH] Added %d watches (%d requested)", added, count);
+}
+
+
+//stop reporting a source directory; the filesystem mark stays for the other sources on it 
+static void fanotify_remove_watch(const char *src){
+    for(int i = 0; i < source_count; i++){
+        if(strcmp(source_table[i].src, src) == 0){
+            source_table[i] = source_table[--source_count];
+            log_and_print("[WATCH] Removing watch from: %s", src);
+            return;
+        }
+    }
+}
+
+
+//find the source directory whose handle matches the parent reported by an event 
+static const char *find_source(const __kernel_fsid_t *fsid, const struct file_handle *fh){
+    for(int i = 0; i < source_count; i++){
+        fanotify_source *entry = &source_table[i];
+        if(entry->handle_type == fh->handle_type && entry->handle_bytes == fh->handle_bytes &&
+           memcmp(&entry->fsid, fsid, sizeof(fsid_t)) == 0 && memcmp(entry->handle, fh->f_handle, fh->handle_bytes) == 0){
+            return entry->src;
+        }
+    }
+    return NULL;
+}
+
+
+//read fanotify events and feed the ones inside monitored sources to the event pipeline 
+static void handle_fanotify_events(){
+
+    char buffer[FANOTIFY_BUF_LEN] __attribute__((aligned(__alignof__(struct fanotify_event_metadata))));
+    trace_monitor_read();
+    ssize_t length = read(fanotify_fd, buffer, sizeof(buffer));
+    if(length <= 0){
+        if(errno != EAGAIN){
+            perror("read");
+        }
+        return;
+    }
+
+    struct fanotify_event_metadata *metadata = (struct fanotify_event_metadata *)buffer;
+    for(; FAN_EVENT_OK(metadata, length); metadata = FAN_EVENT_NEXT(metadata, length)){
+        if(metadata->vers != FANOTIFY_METADATA_VERSION){
+            break;
+        }
+        if(metadata->mask & FAN_Q_OVERFLOW){
+            monitor_overflow();
+            continue;
+        }
+        if(metadata->mask & FAN_ONDIR){
+            continue;  //only files are synchronized 
+        }
+
+        //identify event type 
+        const char *type = NULL;
+        if(metadata->mask & FAN_CREATE){
+            type = "ADDED";
+        }
+        if(metadata->mask & FAN_MODIFY){
+            type = "MODIFIED";
+        }
+        if(metadata->mask & FAN_DELETE){
+            type = "DELETED";
+        }
+
+        struct fanotify_event_info_fid *fid = (struct fanotify_event_info_fid *)(metadata + 1);
+        if(!type || metadata->event_len <= sizeof(*metadata) || fid->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME){
+            continue;
+        }
+
+        //the name follows the parent directory handle 
+        struct file_handle *fh = (struct file_handle *)fid->handle;
+        const char *name = (const char *)(fh->f_handle + fh->handle_bytes);
+        const char *src = find_source(&fid->fsid, fh);
+        if(src && strcmp(name, ".") != 0){
+            monitor_event(src, name, type);
+        }
+    }
+}
+
+
+monitor_backend fanotify_backend = {"fanotify", init_fanotify, fanotify_add_watch, fanotify_add_watches, fanotify_remove_watch, handle_fanotify_events, fanotify_get_fd};
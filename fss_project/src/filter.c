@@ -0,0 +1,154 @@
+#include "../include/filter.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <fnmatch.h>
+
+
+void filter_init(filter_set *set){
+    memset(set, 0, sizeof(*set));
+}
+
+
+//check whether a pattern contains glob characters in [from, to)
+static int has_wildcard(const char *pattern, int from, int to){
+    for(int i = from; i < to; i++){
+        if(pattern[i] == '*' || pattern[i] == '?' || pattern[i] == '[' || pattern[i] == '\\'){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+//classify a pattern so the common shapes are matched with a plain compare instead of fnmatch 
+int filter_add(filter_set *set, const char *pattern, int exclude){
+
+    int length = strlen(pattern);
+    if(length == 0){
+        return -1;
+    }
+
+    //the workers only get the rules of the spec: a rule that does not fit is refused, not applied by the manager alone 
+    size_t used = strlen(set->spec);
+    if(used + length + 10 > sizeof(set->spec)){
+        fprintf(stderr, "Filter rule %s does not fit the %d byte filter spec, rule refused\n", pattern, FILTER_SPEC_LEN);
+        return -1;
+    }
+
+    filter_rule *grown = realloc(set->rules, (set->count + 1) * sizeof(filter_rule));
+    if(!grown){
+        return -1;
+    }
+    set->rules = grown;
+    filter_rule *rule = &set->rules[set->count];
+    rule->exclude = exclude;
+
+    if(!has_wildcard(pattern, 0, length)){
+        rule->kind = FILTER_LITERAL;
+        rule->text = strdup(pattern);
+    } else if(pattern[0] == '*' && !has_wildcard(pattern, 1, length)){
+        rule->kind = FILTER_SUFFIX;
+        rule->text = strdup(pattern + 1);
+    } else if(pattern[length - 1] == '*' && !has_wildcard(pattern, 0, length - 1)){
+        rule->kind = FILTER_PREFIX;
+        rule->text = strndup(pattern, length - 1);
+    } else{
+        rule->kind = FILTER_GLOB;
+        rule->text = strdup(pattern);
+    }
+    if(!rule->text){
+        return -1;
+    }
+    rule->length = strlen(rule->text);
+    set->count++;
+
+    if(exclude){
+        //a name can only match if it ends with the rule's last character 
+        unsigned char last = pattern[length - 1];
+        if(rule->kind == FILTER_PREFIX || rule->length == 0 || last == '*' || last == '?' || last == ']'){
+            set->any_last = 1;
+        } else{
+            set->last_chars[last / 8] |= 1 << (last % 8);
+        }
+    } else{
+        set->includes++;
+    }
+
+    //keep the text so the same rules can be handed to the workers 
+    snprintf(set->spec + used, sizeof(set->spec) - used, "%s%s=%s", used ? " " : "", exclude ? "exclude" : "include", pattern);
+    return 0;
+}
+
+
+int filter_parse(filter_set *set, const char *spec){
+
+    char buffer[FILTER_SPEC_LEN];
+    strncpy(buffer, spec, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+
+    int result = 0;
+    char *saveptr;
+    for(char *token = strtok_r(buffer, " \t\n", &saveptr); token; token = strtok_r(NULL, " \t\n", &saveptr)){
+        if(strncmp(token, "exclude=", 8) == 0){
+            result |= filter_add(set, token + 8, 1);
+        } else if(strncmp(token, "include=", 8) == 0){
+            result |= filter_add(set, token + 8, 0);
+        } else{
+            result = -1;
+        }
+    }
+    return result;
+}
+
+
+static int rule_matches(const filter_rule *rule, const char *name, int length){
+    switch(rule->kind){
+        case FILTER_LITERAL:
+            return length == rule->length && memcmp(name, rule->text, length) == 0;
+        case FILTER_SUFFIX:
+            return length >= rule->length && memcmp(name + length - rule->length, rule->text, rule->length) == 0;
+        case FILTER_PREFIX:
+            return length >= rule->length && memcmp(name, rule->text, rule->length) == 0;
+        default:
+            return fnmatch(rule->text, name, 0) == 0;
+    }
+}
+
+
+//exclude rules win over include rules; with include rules present, a name must match one of them 
+int filter_excluded(const filter_set *set, const char *name){
+
+    if(set->count == 0){
+        return 0;
+    }
+
+    int length = strlen(name);
+    unsigned char last = length > 0 ? name[length - 1] : 0;
+    int may_exclude = set->any_last || (set->last_chars[last / 8] & (1 << (last % 8)));
+    if(!may_exclude && set->includes == 0){
+        return 0;  //most names are rejected by the last character alone 
+    }
+
+    int included = (set->includes == 0);
+    for(int i = 0; i < set->count; i++){
+        const filter_rule *rule = &set->rules[i];
+        if(rule->exclude){
+            if(may_exclude && rule_matches(rule, name, length)){
+                return 1;
+            }
+        } else if(!included && rule_matches(rule, name, length)){
+            included = 1;
+        }
+    }
+    return !included;
+}
+
+
+void filter_free(filter_set *set){
+    for(int i = 0; i < set->count; i++){
+        free(set->rules[i].text);
+    }
+    free(set->rules);
+    filter_init(set);
+}
@@ -6,6 +6,7 @@
 #include <time.h>
 #include <getopt.h>
 #include <errno.h>
+#include "../include/status_shm.h"
 
 #define PIPE_IN "fss_in" //named pipe for sending commands to manager 
 #define PIPE_OUT "fss_out" //named pipe for receiving responses from manager 
@@ -73,6 +74,47 @@ void read_and_log_response(int out_fd, FILE *log_file){
 }
 
 
+//answer "status <source>" from the shared status table of the manager, without a round trip through the pipes 
+//(returns 0 if there is no table, the command then goes to the manager as before)
+int read_shared_status(const char *input, FILE *log_file){
+
+    char command[32], source_path[256], extra[8];
+    if(sscanf(input, "%31s %255s %7s", command, source_path, extra) != 2 || strcmp(command, "status") != 0){
+        return 0;
+    }
+    const status_table *table = status_attach();
+    if(!table){
+        return 0;
+    }
+
+    //same output as the manager's reply: "Directory:" and one block per target 
+    char reply[16 * 4096];  //a source has up to 16 targets 
+    size_t len = 0;
+    status_entry entry;
+    int slot = status_find(table, source_path, 0, &entry);
+    if(slot < 0){
+        len = snprintf(reply, sizeof(reply), "Directory not monitored: %s\n", source_path);
+    } else{
+        len = snprintf(reply, sizeof(reply), "Directory: %s\n", source_path);
+        while(slot >= 0 && len < sizeof(reply) - 1){
+            len += status_format_entry(&entry, reply + len, sizeof(reply) - len);
+            slot = status_find(table, source_path, slot + 1, &entry);
+        }
+    }
+    status_detach(table);
+
+    puts("Manager says:\n");
+    char ts[64];
+    get_timestamp(ts, sizeof(ts));
+    for(char *line = strtok(reply, "\n"); line; line = strtok(NULL, "\n")){
+        printf("%s\n", line);
+        fprintf(log_file, "[%s] Response %s\n", ts, line);
+    }
+    fflush(log_file);
+    return 1;
+}
+
+
 int main(int argc, char *argv[]){
     char *logname = NULL;
     int opt;
@@ -133,6 +175,11 @@ int main(int argc, char *argv[]){
         fprintf(log_file, "[%s] Command %s\n", ts, input);
         fflush(log_file);
 
+        //status queries are read from shared memory while the manager publishes it 
+        if(read_shared_status(input, log_file)){
+            continue;
+        }
+
         //send command to manager 
         if(dprintf(in_fd, "%s\n", input) < 0){
             perror("write to pipe");
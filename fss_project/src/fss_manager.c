@@ -1,6 +1,8 @@
 #include "../include/fss_manager.h"
-#include "../include/inotify_utils.h"
 #include "../include/manager_utils.h"
+#include "../include/monitor.h"
+#include "../include/autoscale.h"
+#include "../include/trace.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -11,23 +13,35 @@
 #include <getopt.h>
 #include <errno.h>
 #include <poll.h>
+#include <time.h>
 
 
 int max_workers = MAX_WORKERS;
 char manager_log_path[PATH_MAX];
 char config_file_path[PATH_MAX];
+char monitor_backend_name[32] = "inotify";
+char trace_file_path[PATH_MAX] = "";  //-t: trace written on shutdown 
 
+#define STARTUP_POLL_MS 100  //poll timeout while initial full syncs are still scheduled in waves 
+
+
+//shorten a poll timeout to the given wait (-1 means no wait) 
+static int earliest(int timeout, int wait_ms){
+    if(wait_ms >= 0 && (timeout < 0 || wait_ms < timeout)){
+        return wait_ms;
+    }
+    return timeout;
+}
 
-int main(int argc, char *argv[]){
 
-    init_inotify();
+int main(int argc, char *argv[]){
 
     strcpy(manager_log_path, MANAGER_LOG);
     strcpy(config_file_path, CONFIG_FILE);
 
     //parse command-line arguments 
     int option;
-    while((option = getopt(argc, argv, "l:c:n:")) != -1){
+    while((option = getopt(argc, argv, "l:c:n:m:t:")) != -1){
         switch(option){
             case 'l':
                 strncpy(manager_log_path, optarg, sizeof(manager_log_path) - 1);
@@ -40,13 +54,32 @@ int main(int argc, char *argv[]){
             case 'n':
                 max_workers = atoi(optarg);
                 break;
+            case 'm':
+                strncpy(monitor_backend_name, optarg, sizeof(monitor_backend_name) - 1);
+                break;
+            case 't':
+                strncpy(trace_file_path, optarg, sizeof(trace_file_path) - 1);
+                break;
             default:
-                fprintf(stderr, "Usage: %s [-l log_file] [-c config_file] [-n worker_limit]\n", argv[0]);
+                fprintf(stderr, "Usage: %s [-l log_file] [-c config_file] [-n worker_limit] [-m inotify|fanotify] [-t trace_file]\n", argv[0]);
                 exit(EXIT_FAILURE);
         }
     }
 
 
+    //-n is the ceiling for the adaptive worker concurrency 
+    if(max_workers < 1 || max_workers > MAX_RUNNING_WORKERS){
+        fprintf(stderr, "Worker limit must be between 1 and %d\n", MAX_RUNNING_WORKERS);
+        exit(EXIT_FAILURE);
+    }
+    autoscale_init(max_workers);
+    srand(time(NULL) ^ getpid());  //retry jitter 
+
+    //select the filesystem monitoring backend 
+    if(init_monitor(monitor_backend_name) != 0){
+        exit(1);
+    }
+
     //setup signal handler for SIGCHLD (child process termination)
     struct sigaction sa; 
     sa.sa_handler = child_signal_handler; //call the handler function when a child process terminates
@@ -57,6 +90,19 @@ int main(int argc, char *argv[]){
         exit(1);
     }
 
+    //a worker that exits early must not kill the manager while it writes a batch list 
+    signal(SIGPIPE, SIG_IGN);
+
+    //SIGHUP reloads the config file 
+    struct sigaction hup;
+    hup.sa_handler = reload_signal_handler;
+    sigemptyset(&hup.sa_mask);
+    hup.sa_flags = SA_RESTART;
+    if(sigaction(SIGHUP, &hup, NULL) == -1){
+        perror("sigaction");
+        exit(1);
+    }
+
     manager_log_file = fopen(manager_log_path, "a"); //open log file
     if(!manager_log_file){
         perror("log file");
@@ -65,6 +111,11 @@ int main(int argc, char *argv[]){
 
     log_and_print("[MANAGER STARTED]");
 
+    //pair states are published in shared memory for fss_status, fss_console and fss_script.sh 
+    if(open_status_table() != 0){
+        log_and_print("[STATUS] Shared status table unavailable, status is served through the console only");
+    }
+
     //create and clean named pipes if needed
     unlink(PIPE_IN);
     unlink(PIPE_OUT);
@@ -88,31 +139,69 @@ int main(int argc, char *argv[]){
 
     out_fd = pipe_out;
 
-    load_config(config_file_path); //load config file and add watches 
+    load_config(config_file_path); //load config file, its watches are added in batches below 
+    load_verify_state(); //resume interrupted verifies 
 
+    int watches_pending = register_pending_watches();  //first batch of watches 
+    int initial_pending = schedule_initial_syncs();  //first wave of initial full syncs 
     dispatch_workers(out_fd); //start initial workers
 
-    //setup poll to monitor pipe and inotify fd 
-    struct pollfd fds[2];
+    //setup poll to monitor pipe, filesystem monitor fd and the report pipes of running workers 
+    struct pollfd fds[2 + MAX_RUNNING_WORKERS];
     fds[0].fd = pipe_in;
     fds[0].events = POLLIN;
-    fds[1].fd = inotify_fd;
     fds[1].events = POLLIN;
 
     while(1){
 
+        //the backend may change when fanotify marks are refused 
+        fds[1].fd = monitor->get_fd();
+
+        //queue the snapshots and scrubs that are due, then wake up for the next one or the next startup wave 
+        int timeout = schedule_periodic_tasks();
+        dispatch_workers(out_fd);
+        if(initial_pending){
+            timeout = earliest(timeout, STARTUP_POLL_MS);
+        }
+        //the remaining watches are added between polls, commands and events are served meanwhile 
+        if(watches_pending){
+            timeout = 0;
+        }
+        //the concurrency limit is re-evaluated once per window while there is work 
+        if(workers_busy()){
+            timeout = earliest(timeout, AUTOSCALE_WINDOW_MS);
+        }
+        //wake up for the next worker deadline and the next retry 
+        timeout = earliest(timeout, check_worker_deadlines());
+        timeout = earliest(timeout, next_retry_ms());
+        timeout = earliest(timeout, publish_status());
+        int worker_fds = worker_poll_fds(fds + 2, MAX_RUNNING_WORKERS);
+
         int ret;
         do{
-            ret = poll(fds, 2, -1);  //infinite timeout
-        } while (ret == -1 && errno == EINTR); //retry if interrupted by signal 
+            ret = poll(fds, 2 + worker_fds, timeout);
+        } while (ret == -1 && errno == EINTR && !reload_requested && !worker_done); //retry if interrupted by signal 
 
-        if(ret == -1){
+        if(ret == -1 && errno != EINTR){
             perror("poll");
             break;
         }
 
+        //reload the config file after SIGHUP 
+        if(reload_requested){
+            reload_requested = 0;
+            int added, removed, kept;
+            if(reload_config(config_file_path, &added, &removed, &kept) == 0){
+                log_and_print("[RELOAD] %d added, %d removed, %d unchanged", added, removed, kept);
+            } else{
+                log_and_print("[RELOAD] Cannot read config file: %s", config_file_path);
+            }
+            initial_pending = 1;
+            watches_pending = 1;
+        }
+
         //handle input from console 
-        if(fds[0].revents & POLLIN){
+        if(ret > 0 && (fds[0].revents & POLLIN)){
             char buf[256];
             memset(buf, 0, sizeof(buf));
             int n = read(pipe_in, buf, sizeof(buf) - 1);
@@ -125,22 +214,51 @@ int main(int argc, char *argv[]){
                     break;
                 }
                 handle_command(buf, pipe_out);
+                initial_pending = 1;  //a reload may have added pairs 
+                watches_pending = 1;
+                dispatch_workers(out_fd);
             }
         }
 
         //handle file system events
-        if(fds[1].revents & POLLIN){
-            handle_inotify_events();
+        if(ret > 0 && (fds[1].revents & POLLIN)){
+            monitor->handle_events();
+            dispatch_workers(out_fd);
         }
     
-        //handle completed workers 
+        //collect worker reports, then start queued tasks in the freed slots 
+        if(ret > 0){
+            handle_worker_output(fds + 2, worker_fds);
+        }
         if(worker_done){
-            dispatch_workers(out_fd);
             worker_done = 0;
         }
+        dispatch_workers(out_fd);
+
+        //add the next batch of watches, then start the next wave of initial full syncs in the background 
+        if(watches_pending){
+            watches_pending = register_pending_watches();
+        }
+        if(initial_pending){
+            initial_pending = schedule_initial_syncs();
+            dispatch_workers(out_fd);
+        }
 
     }
 
+    //let the running workers finish so their results are logged 
+    wait_running_workers();
+
+    if(trace_file_path[0] != '\0'){
+        int spans = trace_dump(trace_file_path);
+        if(spans < 0){
+            perror("trace file");
+        } else{
+            log_and_print("[TRACE] %d spans written to %s", spans, trace_file_path);
+        }
+    }
+
+    close_status_table();
     close(pipe_in);
     close(pipe_out);
     fclose(manager_log_file);
@@ -0,0 +1,109 @@
+#include "../include/status_shm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+
+//read-only status tool: prints the pair states that fss_manager publishes in shared memory,
+//without sending anything to the manager
+
+
+//print one line per published pair, optionally only active or only inactive ones
+void list_pairs(const status_table *table, int only_active, int only_inactive){
+
+    status_summary summary;
+    status_read_summary(table, &summary);
+
+    for(int slot = 0; slot < summary.count; slot++){
+        status_entry entry;
+        status_read_entry(table, slot, &entry);
+        if((only_active && !entry.active) || (only_inactive && entry.active)){
+            continue;
+        }
+        printf("%s -> %s [Last Sync: %s] [%s] [%s] [Errors: %d] [Queued: %d]%s%s\n", entry.src, entry.trg, entry.last_sync, entry.result, entry.active ? "Active" : "Inactive", entry.errors, entry.queued, entry.running ? " [Running]" : "", entry.degraded ? " [Degraded]" : "");
+    }
+}
+
+
+//print the status blocks of every target of a source, as the status command does (returns 0 if the source is not published)
+int show_source(const status_table *table, const char *src){
+
+    status_entry entry;
+    int slot = status_find(table, src, 0, &entry);
+    if(slot < 0){
+        printf("Directory not monitored: %s\n", src);
+        return 0;
+    }
+
+    printf("Directory: %s\n", src);
+    while(slot >= 0){
+        char block[4096];
+        status_format_entry(&entry, block, sizeof(block));
+        fputs(block, stdout);
+        slot = status_find(table, src, slot + 1, &entry);
+    }
+    return 1;
+}
+
+
+//print the manager wide counters
+void show_summary(const status_table *table){
+
+    status_summary summary;
+    status_read_summary(table, &summary);
+
+    char ts[64];
+    time_t updated = summary.updated;
+    strftime(ts, sizeof(ts), "%F %T", localtime(&updated));
+    printf("Manager: pid %d, updated %s\n", (int)summary.manager_pid, ts);
+    printf("Pairs: %d%s\n", summary.count, summary.dropped > 0 ? " (some pairs did not fit into the table)" : "");
+    printf("Queue: %d tasks, %d/%d workers running\n", summary.queue_depth, summary.running_workers, summary.worker_limit);
+}
+
+
+int main(int argc, char *argv[]){
+
+    int only_active = 0;
+    int only_inactive = 0;
+    int summary = 0;
+
+    //parse command-line arguments
+    int option;
+    while((option = getopt(argc, argv, "ais")) != -1){
+        switch(option){
+            case 'a':
+                only_active = 1;
+                break;
+            case 'i':
+                only_inactive = 1;
+                break;
+            case 's':
+                summary = 1;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-a | -i] [-s] [source]\n", argv[0]);
+                exit(1);
+        }
+    }
+
+    const status_table *table = status_attach();
+    if(!table){
+        fprintf(stderr, "fss_manager is not running (no status table)\n");
+        exit(2);
+    }
+
+    int result = 0;
+    if(summary){
+        show_summary(table);
+    }
+    if(optind < argc){
+        result = show_source(table, argv[optind]) ? 0 : 1;
+    } else if(!summary || only_active || only_inactive){
+        list_pairs(table, only_active, only_inactive);
+    }
+
+    status_detach(table);
+    return result;
+}
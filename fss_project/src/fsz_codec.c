@@ -0,0 +1,267 @@
+#include "../include/fsz_codec.h"
+#include <string.h>
+
+
+//block format (LZ4 style): a sequence is a token byte with the literal count in the high and the match length
+//minus FSZ_MIN_MATCH in the low nibble (15 means more length bytes follow, 255 means keep adding),
+//the literals, and a 2-byte little-endian match offset; the last sequence of a block has literals only
+
+#define FSZ_MIN_MATCH 4
+#define FSZ_LAST_LITERALS 5  //the end of a block is always emitted as literals
+#define FSZ_HASH_BITS 12
+#define FSZ_MAX_OFFSET 65535
+#define FSZ_SKIP_SHIFT 6  //after 64 misses in a row the search steps 2 bytes, after 128 3 bytes, ...
+
+
+static void put_u32(char *buffer, unsigned int value){
+    for(int i = 0; i < 4; i++){
+        buffer[i] = (char)(value >> (8 * i));
+    }
+}
+
+static void put_u64(char *buffer, unsigned long long value){
+    for(int i = 0; i < 8; i++){
+        buffer[i] = (char)(value >> (8 * i));
+    }
+}
+
+static unsigned int get_u32(const char *buffer){
+    unsigned int value = 0;
+    for(int i = 0; i < 4; i++){
+        value |= (unsigned int)(unsigned char)buffer[i] << (8 * i);
+    }
+    return value;
+}
+
+static unsigned long long get_u64(const char *buffer){
+    unsigned long long value = 0;
+    for(int i = 0; i < 8; i++){
+        value |= (unsigned long long)(unsigned char)buffer[i] << (8 * i);
+    }
+    return value;
+}
+
+
+//header layout: magic[4] version[1] flags[1] reserved[2] size[8] mtime_sec[8] mtime_nsec[4] mode[4], little-endian
+void fsz_write_header(char *buffer, const fsz_header *header){
+    memset(buffer, 0, FSZ_HEADER_SIZE);
+    memcpy(buffer, FSZ_MAGIC, 4);
+    buffer[4] = FSZ_VERSION;
+    put_u64(buffer + 8, header->size);
+    put_u64(buffer + 16, (unsigned long long)header->mtime_sec);
+    put_u32(buffer + 24, (unsigned int)header->mtime_nsec);
+    put_u32(buffer + 28, header->mode);
+}
+
+
+int fsz_read_header(const char *buffer, fsz_header *header){
+    if(memcmp(buffer, FSZ_MAGIC, 4) != 0 || buffer[4] != FSZ_VERSION){
+        return -1;
+    }
+    header->size = get_u64(buffer + 8);
+    header->mtime_sec = (long long)get_u64(buffer + 16);
+    header->mtime_nsec = get_u32(buffer + 24);
+    header->mode = get_u32(buffer + 28);
+    return 0;
+}
+
+
+static unsigned int hash4(const unsigned char *p){
+    unsigned int value;
+    memcpy(&value, p, 4);
+    return (value * 2654435761u) >> (32 - FSZ_HASH_BITS);
+}
+
+
+//write a length that did not fit into its nibble
+static unsigned char *put_length(unsigned char *op, int length){
+    while(length >= 255){
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (unsigned char)length;
+    return op;
+}
+
+
+//emit one sequence (returns the new output position, NULL if it does not fit)
+static unsigned char *put_sequence(unsigned char *op, unsigned char *out_end, const unsigned char *literals, int lit_len, int offset, int match_len){
+
+    //worst case: token, length bytes of both fields, literals and offset
+    if(out_end - op < 1 + lit_len / 255 + 1 + lit_len + 2 + match_len / 255 + 1){
+        return NULL;
+    }
+    unsigned char *token = op++;
+    *token = (unsigned char)((lit_len >= 15 ? 15 : lit_len) << 4);
+    if(lit_len >= 15){
+        op = put_length(op, lit_len - 15);
+    }
+    memcpy(op, literals, lit_len);
+    op += lit_len;
+
+    if(offset > 0){
+        *op++ = (unsigned char)(offset & 0xff);
+        *op++ = (unsigned char)(offset >> 8);
+        int length = match_len - FSZ_MIN_MATCH;
+        *token |= (unsigned char)(length >= 15 ? 15 : length);
+        if(length >= 15){
+            op = put_length(op, length - 15);
+        }
+    }
+    return op;
+}
+
+
+//greedy single-probe match finder: one hash table slot per 4-byte prefix, like LZ4's fast mode
+int fsz_compress_block(const char *src, int size, char *dst, int capacity){
+
+    const unsigned char *in = (const unsigned char *)src;
+    const unsigned char *ip = in;
+    const unsigned char *anchor = in;
+    const unsigned char *end = in + size;
+    const unsigned char *limit = size > FSZ_LAST_LITERALS + FSZ_MIN_MATCH ? end - FSZ_LAST_LITERALS : in;
+    unsigned char *op = (unsigned char *)dst;
+    unsigned char *out_end = op + (capacity < size ? capacity : size - 1);  //the result must shrink
+    if(size <= 0 || out_end <= op){
+        return 0;
+    }
+
+    int table[1 << FSZ_HASH_BITS];
+    memset(table, 0xff, sizeof(table));  //-1: no position yet
+    int misses = 0;
+
+    while(ip + FSZ_MIN_MATCH <= limit){
+        unsigned int h = hash4(ip);
+        int candidate = table[h];
+        table[h] = (int)(ip - in);
+
+        if(candidate < 0 || (ip - in) - candidate > FSZ_MAX_OFFSET || memcmp(in + candidate, ip, FSZ_MIN_MATCH) != 0){
+            ip += 1 + (misses++ >> FSZ_SKIP_SHIFT);  //incompressible data is skipped faster
+            continue;
+        }
+        misses = 0;
+
+        const unsigned char *ref = in + candidate;
+        int length = FSZ_MIN_MATCH;
+        while(ip + length < limit && ref[length] == ip[length]){
+            length++;
+        }
+
+        op = put_sequence(op, out_end, anchor, (int)(ip - anchor), (int)(ip - ref), length);
+        if(!op){
+            return 0;
+        }
+        ip += length;
+        anchor = ip;
+        if(ip - 2 >= in && ip + FSZ_MIN_MATCH <= limit){
+            table[hash4(ip - 2)] = (int)(ip - 2 - in);
+        }
+    }
+
+    op = put_sequence(op, out_end, anchor, (int)(end - anchor), 0, 0);
+    if(!op){
+        return 0;
+    }
+    return (int)(op - (unsigned char *)dst);
+}
+
+
+//read a length continued in extra bytes (returns -1 past the end of the input)
+static int get_length(const unsigned char **ip, const unsigned char *end, int length){
+    unsigned char byte;
+    do{
+        if(*ip >= end){
+            return -1;
+        }
+        byte = *(*ip)++;
+        length += byte;
+    } while(byte == 255);
+    return length;
+}
+
+
+//every length and offset is checked, so a damaged block fails instead of writing outside dst
+int fsz_decompress_block(const char *src, int size, char *dst, int capacity){
+
+    const unsigned char *ip = (const unsigned char *)src;
+    const unsigned char *end = ip + size;
+    unsigned char *out = (unsigned char *)dst;
+    unsigned char *op = out;
+    unsigned char *out_end = out + capacity;
+
+    while(ip < end){
+        int token = *ip++;
+
+        int lit_len = token >> 4;
+        if(lit_len == 15 && (lit_len = get_length(&ip, end, lit_len)) < 0){
+            return -1;
+        }
+        if(lit_len > end - ip || lit_len > out_end - op){
+            return -1;
+        }
+        memcpy(op, ip, lit_len);
+        op += lit_len;
+        ip += lit_len;
+        if(ip == end){
+            break;  //last sequence
+        }
+
+        if(end - ip < 2){
+            return -1;
+        }
+        int offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if(offset == 0 || offset > op - out){
+            return -1;
+        }
+        int match_len = token & 15;
+        if(match_len == 15 && (match_len = get_length(&ip, end, match_len)) < 0){
+            return -1;
+        }
+        match_len += FSZ_MIN_MATCH;
+        if(match_len > out_end - op){
+            return -1;
+        }
+
+        //overlapping matches repeat the last offset bytes, so they are copied forward byte by byte
+        const unsigned char *ref = op - offset;
+        if(offset >= match_len){
+            memcpy(op, ref, match_len);
+        } else{
+            for(int i = 0; i < match_len; i++){
+                op[i] = ref[i];
+            }
+        }
+        op += match_len;
+    }
+    return (int)(op - out);
+}
+
+
+//block layout: raw_length[4] stored_length[4] data; FSZ_RAW_FLAG in stored_length marks a raw block
+int fsz_write_block(const char *raw, int size, char *out){
+    int stored = fsz_compress_block(raw, size, out + FSZ_BLOCK_HEADER, size);
+    unsigned int flag = 0;
+    if(stored == 0){
+        memcpy(out + FSZ_BLOCK_HEADER, raw, size);
+        stored = size;
+        flag = FSZ_RAW_FLAG;
+    }
+    put_u32(out, (unsigned int)size);
+    put_u32(out + 4, (unsigned int)stored | flag);
+    return FSZ_BLOCK_HEADER + stored;
+}
+
+
+int fsz_block_info(const char *buffer, int *raw_size, int *stored_size, int *is_raw){
+    unsigned int raw = get_u32(buffer);
+    unsigned int stored = get_u32(buffer + 4);
+    *is_raw = (stored & FSZ_RAW_FLAG) != 0;
+    stored &= ~FSZ_RAW_FLAG;
+    if(raw == 0 || raw > FSZ_BLOCK_SIZE || stored > FSZ_BLOCK_SIZE || (*is_raw && stored != raw)){
+        return -1;
+    }
+    *raw_size = (int)raw;
+    *stored_size = (int)stored;
+    return 0;
+}
@@ -1,6 +1,8 @@
 #include "../include/inotify_utils.h"
 #include "../include/sync_list.h"
 #include "../include/manager_utils.h"
+#include "../include/monitor.h"
+#include "../include/trace.h"
 #include <sys/inotify.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -16,39 +18,90 @@ int watch_count = 0;
 watch_entry watch_table[MAX_PAIRS];
 
 
-void init_inotify(){
+int init_inotify(){
     inotify_fd = inotify_init1(IN_NONBLOCK);
     if(inotify_fd < 0){
         perror("inotify_init");
-        exit(1);
+        return -1;
     }
+    return 0;
 }
 
 
-//add a directory to the inotify watch list 
-void add_watch(const char *src){
+//descriptor polled by the manager for inotify events 
+static int inotify_get_fd(){
+    return inotify_fd;
+}
+
+
+monitor_backend inotify_backend = {"inotify", init_inotify, add_watch, add_watches, remove_watch, handle_inotify_events, inotify_get_fd};
+
+
+//watch a directory without logging it (returns 1 if added, 0 if already watched, -1 on error)
+static int watch_directory(const char *src){
+
+    //a source fanning out to several targets is watched only once 
+    for(int i = 0; i < watch_count; i++){
+        if(strcmp(watch_table[i].src, src) == 0){
+            return 0;
+        }
+    }
 
     if(watch_count >= MAX_PAIRS){
         fprintf(stderr, "Watch limit reached.\n");
-        return;
+        return -1;
     }
 
     int wd = inotify_add_watch(inotify_fd, src, IN_CREATE | IN_MODIFY | IN_DELETE);
     if(wd == -1){
         fprintf(stderr, "Could not watch %s\n", src);
-        return;
+        return -1;
     }
 
-    log_and_print("[WATCH] Adding watch to: %s", src);
     watch_table[watch_count].wd = wd;
     strncpy(watch_table[watch_count].src, src, PATH_MAX);
     watch_count++;
+    return 1;
+}
+
+
+//add a directory to the inotify watch list 
+void add_watch(const char *src){
+    if(watch_directory(src) == 1){
+        log_and_print("[WATCH] Adding watch to: %s", src);
+    }
+}
+
+
+//add several directories at once, logging one line for the whole batch 
+void add_watches(const char **srcs, int count){
+    int added = 0;
+    for(int i = 0; i < count; i++){
+        if(watch_directory(srcs[i]) == 1){
+            added++;
+        }
+    }
+    log_and_print("[WATCH] Added %d watches (%d requested)", added, count);
+}
+
+
+//remove a directory from the inotify watch list 
+void remove_watch(const char *src){
+    for(int i = 0; i < watch_count; i++){
+        if(strcmp(watch_table[i].src, src) == 0){
+            inotify_rm_watch(inotify_fd, watch_table[i].wd);
+            log_and_print("[WATCH] Removing watch from: %s", src);
+            watch_table[i] = watch_table[--watch_count];
+            return;
+        }
+    }
 }
 
 
 //handle inotify events and trigger workers accordingly 
 void handle_inotify_events(){
     char buffer[EVENT_BUF_LEN];
+    trace_monitor_read();
     int length = read(inotify_fd, buffer, EVENT_BUF_LEN);
 
     if(length <= 0){
@@ -77,67 +130,17 @@ void handle_inotify_events(){
             }
 
             if(type){
-
-                log_and_print("[INOTIFY] Event detected: %s (%s)", event->name, type);
-
-                //find corresponding source directory 
+                //hand the event to the pair that owns the watched directory 
                 for(int j = 0; j < watch_count; j++){
                     if(watch_table[j].wd == event->wd && watch_table[j].src[0] != '\0'){
-                        sync_node *entry = find_sync_pair(watch_table[j].src);
-                        if(entry && entry->active){
-
-                            //create a pipe for communication 
-                            int pipe_fd[2];
-                            if (pipe(pipe_fd) == -1) {
-                                perror("pipe failed");
-                                continue;
-                            }
-
-                            pid_t pid = fork();
-                            if(pid == 0){
-                                //child process: redirect output and execute worker 
-                                close(pipe_fd[0]); 
-                                dup2(pipe_fd[1], STDOUT_FILENO);
-                                close(pipe_fd[1]);
-                                execl("bin/worker", "worker", entry->src, entry->trg, event->name, type, NULL);
-                                perror("execl failed");
-                                exit(1);
-                            } else if(pid > 0){
-                                //parent process: read report from worker 
-                                close(pipe_fd[1]);
-
-                                char report_buf[1024];
-                                ssize_t n = read(pipe_fd[0], report_buf, sizeof(report_buf) - 1);
-
-                                report_buf[n] = '\0';
-                                close(pipe_fd[0]);
-
-                                //parse the EXEC_REPORT output 
-                                char *status = strstr(report_buf, "STATUS:");
-                                char *details = strstr(report_buf, "DETAILS:");
-                                if(status){
-                                    status += strlen("STATUS:");
-                                }
-                                if(details){
-                                    details += strlen("DETAILS:");
-                                }
-
-                                char status_clean[32];
-                                char details_clean[1024];
-                                sscanf(status, "%31s", status_clean);
-                                sscanf(details, "%1023[^\n]", details_clean);
-
-                                //log the result 
-                                log_worker_report(entry->src, entry->trg, event->name, type, status_clean, details_clean, pid);
-                            } else{
-                                perror("fork failed");
-                            }
-                        }
+                        monitor_event(watch_table[j].src, event->name, type);
                     }
                 }
             }
-            int event_size = sizeof(struct inotify_event) + event->len;
-            i += event_size;
+        } else if(event->mask & IN_Q_OVERFLOW){
+            monitor_overflow();
         }
+        int event_size = sizeof(struct inotify_event) + event->len;
+        i += event_size;
     }
-}
+}
\ No newline at end of file
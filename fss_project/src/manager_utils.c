@@ -1,7 +1,10 @@
 #include "../include/fss_manager.h"
 #include "../include/manager_utils.h"
 #include "../include/sync_list.h"
-#include "../include/inotify_utils.h"
+#include "../include/monitor.h"
+#include "../include/autoscale.h"
+#include "../include/trace.h"
+#include "../include/status_shm.h"
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -10,6 +13,10 @@
 #include <errno.h>
 #include <time.h>
 #include <sys/stat.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <poll.h>
+#include <signal.h>
 
 
 int active_workers = 0;
@@ -19,172 +26,1928 @@ worker_task workers_queue[MAX_QUEUE];
 FILE *manager_log_file = NULL;
 int out_fd = -1;
 volatile sig_atomic_t worker_done = 0;
+volatile sig_atomic_t reload_requested = 0;
+long global_bw_limit = 0;
+long global_file_limit = 0;
+long global_parallel_threshold = 0;
+int global_copy_threads = 0;
+long global_bulk_threshold = -1;
+int startup_wave = INITIAL_SYNC_WAVE;
+long global_scrub_bw_limit = 0;
+long global_event_timeout = DEFAULT_EVENT_TIMEOUT;
+long global_full_timeout = DEFAULT_FULL_TIMEOUT;
+
+
+//a worker whose report is still being read 
+typedef struct{
+    pid_t pid;
+    int report_fd;
+    char src[PATH_MAX];
+    char trg_list[MAX_TARGETS * PATH_MAX];
+    char filename[NAME_MAX + 1];
+    char operation[16];
+    char report[8192];
+    size_t report_len;
+    unsigned long *trace_ids;  //tasks handled by this run 
+    int trace_count;
+    long long spawn_us;  //when the fork started 
+    int attempt;  //highest retry count of the tasks in this run 
+    long long deadline_us;  //SIGTERM is sent after this time (0 = no deadline)
+    long long kill_us;  //SIGKILL is sent after this time, once the worker was terminated 
+    int timed_out;
+    char only_trg[PATH_MAX];  //target an event run was limited to (empty for every target)
+    int limit_fd;  //pipe for limit updates of a background sync (-1 for event runs)
+    long bw_limit;  //limits the worker currently applies 
+    long file_limit;
+}running_worker;
+
+//a failed task waiting for its next attempt, kept apart from the queue so fresh work is never held up by it 
+typedef struct{
+    worker_task task;
+    long long due_us;
+}retry_entry;
+
+static running_worker running[MAX_RUNNING_WORKERS];
+static int running_count = 0;
+static retry_entry retries[MAX_RETRIES];
+static int retry_count = 0;
+static status_table *status_shm = NULL;  //pair states published for readers that bypass the console pipe 
+static long long status_published_us = 0;
+static sync_node *initial_cursor = NULL;  //next pair whose initial full sync is not scheduled yet 
+static sync_node *watch_cursor = NULL;  //next pair whose source may still wait for its watch 
 
 
 //log a simple message with timestamp to the manager log file 
 void log_msg(const char *msg){
 
-    if(!manager_log_file){
-        return;
+    if(!manager_log_file){
+        return;
+    }
+
+    time_t now = time(NULL);
+    char ts[64];
+    strftime(ts, sizeof(ts), "%F %T", localtime(&now));
+    fprintf(manager_log_file, "[%s] %s\n", ts, msg);
+    fflush(manager_log_file);
+}
+
+
+//print a message to stdout and log it to the manager log file 
+void log_and_print(const char *format, ...){
+    va_list args1;
+    va_list args2;
+    va_start(args1, format);
+    va_copy(args2, args1);
+
+    vprintf(format, args1);
+    printf("\n");
+
+    vfprintf(manager_log_file, format, args2);
+    fprintf(manager_log_file, "\n");
+
+    fflush(manager_log_file);
+    va_end(args1);
+    va_end(args2);
+}
+
+
+//signal handler for SIGCHLD: called when a child process terminates 
+void child_signal_handler(int signal_number){
+
+    while(waitpid(-1, NULL, WNOHANG) > 0){
+        active_workers--;
+    }
+    worker_done = 1;
+}
+
+
+//signal handler for SIGHUP: asks the main loop to reload the config file 
+void reload_signal_handler(int signal_number){
+    reload_requested = 1;
+}
+
+
+//append a task at the end of the workers queue (returns 0 if the queue is full)
+static unsigned long push_task(const char *source_path, const char *target_path, const char *filename, const char *operation){
+
+    if((queue_end + 1) % MAX_QUEUE == queue_start){
+        fprintf(manager_log_file, "[QUEUE] Full. Task dropped: %s -> %s (%s %s)\n", source_path, target_path, operation, filename);
+        fflush(manager_log_file);
+        return 0;
+    }
+
+    worker_task *task = &workers_queue[queue_end];
+    strncpy(task->src_path, source_path, PATH_MAX);
+    strncpy(task->trg_path, target_path, PATH_MAX);
+    strncpy(task->filename, filename, NAME_MAX);
+    task->filename[NAME_MAX] = '\0';
+    strncpy(task->operation, operation, sizeof(task->operation) - 1);
+    task->operation[sizeof(task->operation) - 1] = '\0';
+    task->trace_id = trace_new_id();
+    task->queued_us = trace_now_us();
+    task->attempt = 0;
+    queue_end = (queue_end + 1) % MAX_QUEUE;
+    return task->trace_id;
+}
+
+
+//drop the retries that fresh work makes unnecessary (operation NULL matches every operation)
+static void cancel_retries(const char *source_path, const char *filename, const char *operation){
+    for(int i = 0; i < retry_count; i++){
+        worker_task *task = &retries[i].task;
+        if(strcmp(task->src_path, source_path) == 0 && strcmp(task->filename, filename) == 0 && (!operation || strcmp(task->operation, operation) == 0)){
+            retries[i--] = retries[--retry_count];
+        }
+    }
+}
+
+
+//end a verify whose slice will not run again, so later verify commands and scrubs can start a new one 
+static void abandon_verify(const char *source_path, const char *operation){
+    if(strncmp(operation, "VERIFY", 6) == 0){
+        stop_verify(source_path);
+        save_verify_state();
+        log_and_print("[VERIFY] Abandoned: %s", source_path);
+    }
+}
+
+
+//schedule another attempt of a failed task after an exponential backoff with jitter (target_path "" means every target)
+//events that run out of attempts are caught up by one full sync, full syncs and snapshots are given up 
+static void schedule_retry(const char *source_path, const char *target_path, const char *filename, const char *operation, int attempt){
+
+    if(!find_active_pair(source_path)){
+        return;
+    }
+
+    //a retry of the same work already waiting covers this one too 
+    for(int i = 0; i < retry_count; i++){
+        worker_task *task = &retries[i].task;
+        if(strcmp(task->src_path, source_path) == 0 && strcmp(task->filename, filename) == 0 && strcmp(task->operation, operation) == 0){
+            if(strcmp(task->trg_path, target_path) != 0){
+                task->trg_path[0] = '\0';
+            }
+            if(attempt > task->attempt){
+                task->attempt = attempt;
+            }
+            return;
+        }
+    }
+
+    if(attempt > RETRY_LIMIT){
+        if(strcmp(filename, "ALL") != 0){
+            fprintf(manager_log_file, "[RETRY] Giving up %s %s/%s, full sync scheduled instead\n", operation, source_path, filename);
+            schedule_retry(source_path, "", "ALL", "FULL", 1);
+        } else{
+            log_and_print("[RETRY] Giving up %s of %s -> %s after %d attempts", operation, source_path, target_path[0] ? target_path : "all targets", attempt);
+        }
+        abandon_verify(source_path, operation);
+        fflush(manager_log_file);
+        return;
+    }
+    if(retry_count == MAX_RETRIES){
+        fprintf(manager_log_file, "[RETRY] Full. Retry dropped: %s %s/%s\n", operation, source_path, filename);
+        abandon_verify(source_path, operation);
+        fflush(manager_log_file);
+        return;
+    }
+
+    //the delay doubles per attempt; degraded pairs are only probed at the longest delay 
+    long delay_ms = RETRY_MAX_MS;
+    if(attempt - 1 < 20 && ((long)RETRY_BASE_MS << (attempt - 1)) < RETRY_MAX_MS && !source_degraded(source_path, target_path)){
+        delay_ms = (long)RETRY_BASE_MS << (attempt - 1);
+    }
+    //half of the delay is random, so the retries of a failed burst do not all fire at once 
+    delay_ms = delay_ms / 2 + rand() % (delay_ms / 2 + 1);
+
+    retry_entry *entry = &retries[retry_count++];
+    memset(&entry->task, 0, sizeof(entry->task));
+    strncpy(entry->task.src_path, source_path, PATH_MAX - 1);
+    strncpy(entry->task.trg_path, target_path, PATH_MAX - 1);
+    strncpy(entry->task.filename, filename, NAME_MAX);
+    strncpy(entry->task.operation, operation, sizeof(entry->task.operation) - 1);
+    entry->task.attempt = attempt;
+    entry->due_us = trace_now_us() + delay_ms * 1000LL;
+
+    fprintf(manager_log_file, "[RETRY] %s %s/%s in %ld ms (attempt %d)\n", operation, source_path, filename, delay_ms, attempt);
+    fflush(manager_log_file);
+}
+
+
+//move the retries that are due to the end of the workers queue 
+//work of the same kind that is already queued absorbs the retry, a queued event for the file supersedes it 
+static void promote_retries(){
+
+    long long now = trace_now_us();
+    for(int i = 0; i < retry_count; i++){
+        if(retries[i].due_us > now){
+            continue;
+        }
+        worker_task retry = retries[i].task;
+        retries[i--] = retries[--retry_count];
+        if(!find_active_pair(retry.src_path)){
+            continue;
+        }
+
+        int absorbed = 0;
+        for(int k = queue_start; k != queue_end; k = (k + 1) % MAX_QUEUE){
+            worker_task *task = &workers_queue[k];
+            if(strcmp(task->src_path, retry.src_path) != 0 || strcmp(task->filename, retry.filename) != 0){
+                continue;
+            }
+            if(strcmp(retry.filename, "ALL") != 0){
+                //a queued event of the file covers the retry if it reaches the same targets 
+                if(task->trg_path[0] == '\0' || strcmp(task->trg_path, retry.trg_path) == 0){
+                    absorbed = 1;
+                    break;
+                }
+                continue;
+            }
+            if(strcmp(task->operation, retry.operation) == 0){
+                if(strcmp(task->trg_path, retry.trg_path) != 0){
+                    task->trg_path[0] = '\0';
+                }
+                if(retry.attempt > task->attempt){
+                    task->attempt = retry.attempt;
+                }
+                absorbed = 1;
+                break;
+            }
+        }
+        if(absorbed || !push_task(retry.src_path, retry.trg_path, retry.filename, retry.operation)){
+            continue;
+        }
+        workers_queue[(queue_end - 1 + MAX_QUEUE) % MAX_QUEUE].attempt = retry.attempt;
+        fprintf(manager_log_file, "[RETRY] Attempt %d queued: %s %s/%s\n", retry.attempt, retry.operation, retry.src_path, retry.filename);
+        fflush(manager_log_file);
+    }
+}
+
+
+//milliseconds until the next retry is due (-1 if none is waiting)
+int next_retry_ms(){
+    if(retry_count == 0){
+        return -1;
+    }
+    long long next = retries[0].due_us;
+    for(int i = 1; i < retry_count; i++){
+        if(retries[i].due_us < next){
+            next = retries[i].due_us;
+        }
+    }
+    long long wait_ms = (next - trace_now_us()) / 1000 + 1;
+    return wait_ms < 0 ? 0 : (int)wait_ms;
+}
+
+
+//add a new full sync task to the workers queue (target_path NULL means every target of the source)
+void queue_sync_task(const char *source_path, const char *target_path){
+
+    if(!target_path){
+        cancel_retries(source_path, "ALL", "FULL");
+    }
+
+    //a full sync already waiting for this source is widened instead, so the source is read once 
+    for(int i = queue_start; i != queue_end; i = (i + 1) % MAX_QUEUE){
+        worker_task *task = &workers_queue[i];
+        if(strcmp(task->operation, "FULL") == 0 && strcmp(task->src_path, source_path) == 0){
+            if(!target_path || strcmp(task->trg_path, target_path) != 0){
+                task->trg_path[0] = '\0';
+            }
+            fprintf(manager_log_file, "[QUEUE] Merged into queued sync: %s\n", source_path);
+            fflush(manager_log_file);
+            return;
+        }
+    }
+
+    if(push_task(source_path, target_path ? target_path : "", "ALL", "FULL")){
+        fprintf(manager_log_file, "[QUEUE] Task queued: %s -> %s\n", source_path, target_path ? target_path : "all targets");
+        fflush(manager_log_file);
+    }
+}
+
+
+//add a snapshot task to the workers queue (target_path NULL means every target of the source)
+void queue_snapshot_task(const char *source_path, const char *target_path){
+
+    //a snapshot already waiting for this source is widened instead 
+    for(int i = queue_start; i != queue_end; i = (i + 1) % MAX_QUEUE){
+        worker_task *task = &workers_queue[i];
+        if(strcmp(task->operation, "SNAPSHOT") == 0 && strcmp(task->src_path, source_path) == 0){
+            if(!target_path || strcmp(task->trg_path, target_path) != 0){
+                task->trg_path[0] = '\0';
+            }
+            return;
+        }
+    }
+
+    if(push_task(source_path, target_path ? target_path : "", "ALL", "SNAPSHOT")){
+        fprintf(manager_log_file, "[QUEUE] Snapshot queued: %s -> %s\n", source_path, target_path ? target_path : "all targets");
+        fflush(manager_log_file);
+    }
+}
+
+
+//add the next verify slice of a source to the workers queue (its progress is kept in the registry)
+void queue_verify_task(const char *source_path){
+
+    sync_node *pair = find_sync_pair(source_path);
+    if(!pair || !pair->verify_running){
+        return;
+    }
+    const char *operation = pair->verify_deep ? "VERIFY_DEEP" : "VERIFY";
+    for(int i = queue_start; i != queue_end; i = (i + 1) % MAX_QUEUE){
+        if(strcmp(workers_queue[i].operation, operation) == 0 && strcmp(workers_queue[i].src_path, source_path) == 0){
+            return;
+        }
+    }
+    push_task(source_path, "", "ALL", operation);
+}
+
+
+//compute the next due time of a periodic task, shortening it when the interval was lowered 
+static time_t next_due(time_t *due, long interval, time_t now){
+    if(*due > now + interval){
+        *due = now + interval;
+    }
+    return *due;
+}
+
+
+//queue the scheduled snapshots and scrubs that are due (returns the milliseconds until the next one, -1 if none is scheduled)
+int schedule_periodic_tasks(){
+
+    time_t now = time(NULL);
+    time_t next = 0;
+    for(sync_node *curr = sync_list; curr; curr = curr->next){
+        if(!curr->active){
+            continue;
+        }
+        if(curr->snapshot_interval > 0){
+            if(next_due(&curr->next_snapshot, curr->snapshot_interval, now) <= now){
+                queue_snapshot_task(curr->src, curr->trg);
+                curr->next_snapshot = now + curr->snapshot_interval;
+            }
+            if(next == 0 || curr->next_snapshot < next){
+                next = curr->next_snapshot;
+            }
+        }
+        if(curr->scrub_interval > 0){
+            //a scheduled scrub is a deep verify of the whole source 
+            if(next_due(&curr->next_scrub, curr->scrub_interval, now) <= now){
+                if(start_verify(curr->src, 1) == 1){
+                    log_and_print("[VERIFY] Scheduled scrub started: %s", curr->src);
+                    queue_verify_task(curr->src);
+                    save_verify_state();
+                }
+                curr->next_scrub = now + curr->scrub_interval;
+            }
+            if(next == 0 || curr->next_scrub < next){
+                next = curr->next_scrub;
+            }
+        }
+    }
+    if(next == 0){
+        return -1;
+    }
+    if(next - now > 3600){
+        return 3600 * 1000;  //keep the poll timeout in range, the schedule is re-checked on wake up 
+    }
+    return (next - now) * 1000;
+}
+
+
+//add a single file event (ADDED, MODIFIED, DELETED) to the workers queue (returns its trace id, 0 if dropped)
+//target_path NULL means every target of the source, a verify repair names the target that mismatched 
+unsigned long queue_event_task(const char *source_path, const char *target_path, const char *filename, const char *operation){
+    if(!target_path){
+        cancel_retries(source_path, filename, NULL);  //the new event carries the latest state of the file to every target 
+    }
+    return push_task(source_path, target_path ? target_path : "", filename, operation);
+}
+
+
+//pick the smaller of two limits where 0 means unlimited 
+static long min_limit(long a, long b){
+    if(a == 0){
+        return b;
+    }
+    if(b == 0){
+        return a;
+    }
+    return a < b ? a : b;
+}
+
+
+//count the running background syncs (FULL, MIRROR, SNAPSHOT, VERIFY); event runs are not throttled and take no share 
+static int throttled_workers(){
+    int count = 0;
+    for(int i = 0; i < running_count; i++){
+        if(running[i].limit_fd >= 0){
+            count++;
+        }
+    }
+    return count;
+}
+
+
+//the limits of a background sync: its share of the global budget and the strictest target limit 
+//(returns the target whose io class applies)
+static sync_node *throttle_limits(const char *source_path, const char *operation, int sharing_workers, long *bw_out, long *files_out){
+
+    if(sharing_workers < 1){
+        sharing_workers = 1;
+    }
+
+    //the global budget is split evenly between the running background syncs 
+    long bw = global_bw_limit / sharing_workers;
+    long files = global_file_limit / sharing_workers;
+
+    //a fan-out run reads the source once, so the strictest target limit applies 
+    sync_node *pair = NULL;
+    for(sync_node *curr = find_sync_pair(source_path); curr; curr = next_sync_target(curr)){
+        if(curr->active){
+            bw = min_limit(bw, curr->bw_limit);
+            files = min_limit(files, curr->file_limit);
+            if(!pair || curr->ioprio[0] != '\0'){
+                pair = curr;
+            }
+        }
+    }
+    if(global_bw_limit > 0 && bw == 0){
+        bw = 1;
+    }
+    if(global_file_limit > 0 && files == 0){
+        files = 1;
+    }
+
+    //a scrub stays within its own budget 
+    if(strncmp(operation, "VERIFY", 6) == 0){
+        bw = min_limit(bw, global_scrub_bw_limit);
+    }
+
+    *bw_out = bw;
+    *files_out = files;
+    return pair;
+}
+
+
+//export the throttling settings of a background sync and the pipe of its later updates to the worker environment (called in the child)
+static void set_throttle_env(const char *source_path, const char *operation, int sharing_workers, int limit_fd){
+
+    long bw, files;
+    sync_node *pair = throttle_limits(source_path, operation, sharing_workers, &bw, &files);
+
+    char value[32];
+    if(bw > 0){
+        snprintf(value, sizeof(value), "%ld", bw);
+        setenv("FSS_BW_LIMIT", value, 1);
+    }
+    if(files > 0){
+        snprintf(value, sizeof(value), "%ld", files);
+        setenv("FSS_FILE_LIMIT", value, 1);
+    }
+    if(pair && pair->ioprio[0] != '\0'){
+        setenv("FSS_IOPRIO", pair->ioprio, 1);
+    }
+    if(limit_fd >= 0){
+        snprintf(value, sizeof(value), "%d", limit_fd);
+        setenv("FSS_LIMIT_FD", value, 1);
+    }
+}
+
+
+//export the large file copy settings to the worker environment (called in the child)
+static void set_copy_env(){
+    char value[32];
+    if(global_parallel_threshold > 0){
+        snprintf(value, sizeof(value), "%ld", global_parallel_threshold);
+        setenv("FSS_PARALLEL_THRESHOLD", value, 1);
+    }
+    if(global_copy_threads > 0){
+        snprintf(value, sizeof(value), "%d", global_copy_threads);
+        setenv("FSS_COPY_THREADS", value, 1);
+    }
+    if(global_bulk_threshold >= 0){
+        snprintf(value, sizeof(value), "%ld", global_bulk_threshold);
+        setenv("FSS_BULK_THRESHOLD", value, 1);
+    }
+}
+
+
+//export the resume point of a verify run (called in the child, after set_throttle_env)
+static void set_verify_env(const char *source_path){
+
+    sync_node *pair = find_sync_pair(source_path);
+    if(pair){
+        setenv("FSS_VERIFY_FROM", pair->verify_cursor, 1);
+    }
+
+    //a scrub uses idle I/O unless the pair asks otherwise 
+    setenv("FSS_IOPRIO", "idle", 0);
+}
+
+
+//export the include/exclude rules, the dedup mode and store and the compression of every target in the list 
+//as FSS_FILTER_<index>, FSS_DEDUP_<index>, FSS_DEDUP_STORE_<index> and FSS_COMPRESS_<index> (called in the child)
+static void set_target_env(const char *src, const char *trg_list){
+
+    char buffer[MAX_TARGETS * PATH_MAX];
+    strncpy(buffer, trg_list, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+
+    int index = 0;
+    char *saveptr;
+    for(char *trg = strtok_r(buffer, ":", &saveptr); trg; trg = strtok_r(NULL, ":", &saveptr), index++){
+        sync_node *entry = find_sync_target(src, trg);
+        if(entry && entry->filter.count > 0){
+            char name[32];
+            snprintf(name, sizeof(name), "FSS_FILTER_%d", index);
+            setenv(name, entry->filter.spec, 1);
+        }
+        if(entry && entry->dedup[0] != '\0'){
+            char name[32];
+            snprintf(name, sizeof(name), "FSS_DEDUP_%d", index);
+            setenv(name, entry->dedup, 1);
+            if(entry->dedup_store[0] != '\0'){
+                snprintf(name, sizeof(name), "FSS_DEDUP_STORE_%d", index);
+                setenv(name, entry->dedup_store, 1);
+            }
+        }
+        if(entry && entry->compress){
+            char name[32];
+            snprintf(name, sizeof(name), "FSS_COMPRESS_%d", index);
+            setenv(name, "1", 1);
+        }
+    }
+}
+
+
+//extract the status and details lines of a complete worker report 
+static void parse_worker_report(const char *buffer, size_t total, char *status_clean, char *details_clean){
+
+    strcpy(status_clean, "UNKNOWN");
+    strcpy(details_clean, "No details");
+    if(total == 0){
+        strcpy(status_clean, "FAIL");
+        strcpy(details_clean, "No output from worker");
+        return;
+    }
+
+    char *status = strstr(buffer, "STATUS:");
+    char *details = strstr(buffer, "DETAILS:");
+    if(status){
+        sscanf(status + strlen("STATUS:"), "%31s", status_clean);
+    }
+    if(details){
+        sscanf(details + strlen("DETAILS:"), " %1023[^\n]", details_clean);
+    }
+}
+
+
+//fork and exec a worker with its stdout (and optionally stdin) connected to pipes (returns the pid or -1)
+//a throttled run also gets a pipe for limit updates, whose write end is stored in limit_fd (NULL for an unthrottled run)
+static pid_t spawn_worker(const char *src, const char *trg, const char *filename, const char *operation, const char *mirror_mask, int *limit_fd, unsigned long trace_id, int *report_fd, int input_fd){
+
+    int out_pipe[2];
+    if(pipe(out_pipe) == -1){
+        perror("pipe");
+        return -1;
+    }
+
+    int limit_pipe[2] = {-1, -1};
+    if(limit_fd){
+        if(pipe(limit_pipe) == -1){
+            perror("pipe");
+            close(out_pipe[0]);
+            close(out_pipe[1]);
+            return -1;
+        }
+        //neither side may block on an update, and later workers must not inherit the write end 
+        fcntl(limit_pipe[0], F_SETFL, O_NONBLOCK);
+        fcntl(limit_pipe[1], F_SETFL, O_NONBLOCK);
+        fcntl(limit_pipe[1], F_SETFD, FD_CLOEXEC);
+    }
+
+    pid_t worker_pid = fork();
+
+    //a failed fork (e.g. EAGAIN with many workers running) is left to the caller's retry 
+    if(worker_pid < 0){
+        perror("fork failed");
+        close(out_pipe[0]);
+        close(out_pipe[1]);
+        if(limit_fd){
+            close(limit_pipe[0]);
+            close(limit_pipe[1]);
+        }
+        fprintf(manager_log_file, "[SPAWN] Could not fork a worker for %s (%s %s)\n", src, operation, filename);
+        fflush(manager_log_file);
+        return -1;
+    }
+
+    if(worker_pid == 0){
+        //child process: set up stdin/stdout and exec worker 
+        close(out_pipe[0]);  //close read
+        dup2(out_pipe[1], STDOUT_FILENO); 
+        close(out_pipe[1]);
+        if(input_fd >= 0){
+            dup2(input_fd, STDIN_FILENO);
+            close(input_fd);
+        }
+        if(limit_fd){
+            //updates are announced with SIGUSR1, held back until the worker has installed its handler 
+            sigset_t mask;
+            sigemptyset(&mask);
+            sigaddset(&mask, SIGUSR1);
+            sigprocmask(SIG_BLOCK, &mask, NULL);
+            close(limit_pipe[1]);
+            set_throttle_env(src, operation, throttled_workers() + 1, limit_pipe[0]);
+        }
+        if(strncmp(operation, "VERIFY", 6) == 0){
+            set_verify_env(src);
+        }
+        set_copy_env();
+        if(mirror_mask && mirror_mask[0] != '\0'){
+            setenv("FSS_MIRROR_TARGETS", mirror_mask, 1);
+        }
+        set_target_env(src, trg);
+        char trace_value[32];
+        snprintf(trace_value, sizeof(trace_value), "%lu", trace_id);
+        setenv("FSS_TRACE_ID", trace_value, 1);
+        execl("bin/worker", "worker", src, trg, filename, operation, NULL);
+        perror("execl failed");
+        exit(1);
+    }
+
+    //parent process
+    close(out_pipe[1]);  //close write
+    *report_fd = out_pipe[0];
+    if(limit_fd){
+        close(limit_pipe[0]);
+        *limit_fd = limit_pipe[1];
+    }
+    active_workers++;
+    return worker_pid;
+}
+
+
+//log when a target enters or leaves the degraded state 
+static void note_health_change(const char *src, const char *trg, int change){
+    if(change > 0){
+        log_and_print("[DEGRADED] %s -> %s failed %d runs in a row", src, trg, DEGRADED_AFTER);
+    } else if(change < 0){
+        log_and_print("[RECOVERED] %s -> %s", src, trg);
+    }
+}
+
+
+//update and log every target named in the TARGET lines of a report (full_details is used for event runs)
+static void apply_target_reports(const char *src, const char *trg_list, const char *filename, const char *operation, const char *report, const char *status, const char *details, pid_t pid){
+
+    int snapshot = (strcmp(operation, "SNAPSHOT") == 0);
+    int verify = (strncmp(operation, "VERIFY", 6) == 0);
+    int full_sync = (strcmp(filename, "ALL") == 0 && strcmp(operation, "BATCH") != 0 && !snapshot && !verify);
+    int reported = 0;
+
+    const char *line = report;
+    while((line = strstr(line, "TARGET:")) != NULL){
+        char target_status[32], target_dir[PATH_MAX];
+        int copied, failed, pruned;
+        line += strlen("TARGET:");
+        if(sscanf(line, "%31s %d %d %d %4095[^\n]", target_status, &copied, &failed, &pruned, target_dir) != 5){
+            continue;
+        }
+        reported++;
+
+        if(verify){
+            //the sync status is left alone, mismatches are repaired by the queued events 
+            char target_details[128];
+            snprintf(target_details, sizeof(target_details), "%d files match, %d mismatches", copied, failed);
+            log_worker_report(src, target_dir, filename, operation, target_status, target_details, pid);
+            continue;
+        }
+        if(snapshot){
+            //the fourth column of a snapshot report counts the linked files 
+            char target_details[128];
+            snprintf(target_details, sizeof(target_details), "%d files copied, %d linked, %d failed", copied, pruned, failed);
+            note_health_change(src, target_dir, update_snapshot_status(src, target_dir, target_status));
+            log_worker_report(src, target_dir, filename, operation, target_status, target_details, pid);
+            continue;
+        }
+
+        note_health_change(src, target_dir, update_target_status(src, target_dir, target_status, full_sync));
+        if(full_sync){
+            //only the mirror targets of a MIRROR run were pruned 
+            sync_node *entry = find_sync_target(src, target_dir);
+            const char *target_operation = (entry && !entry->mirror) ? "FULL" : operation;
+
+            char target_details[128];
+            if(strcmp(target_operation, "MIRROR") == 0){
+                snprintf(target_details, sizeof(target_details), "%d files copied, %d failed, %d pruned", copied, failed, pruned);
+            } else{
+                snprintf(target_details, sizeof(target_details), "%d files copied, %d failed", copied, failed);
+            }
+            log_worker_report(src, target_dir, filename, target_operation, target_status, target_details, pid);
+        } else{
+            log_worker_report(src, target_dir, filename, operation, target_status, details, pid);
+        }
+    }
+
+    //no per-target lines (the worker failed early): the whole run counts for every target 
+    if(reported == 0){
+        char buffer[MAX_TARGETS * PATH_MAX];
+        strncpy(buffer, trg_list, sizeof(buffer) - 1);
+        buffer[sizeof(buffer) - 1] = '\0';
+        char *saveptr;
+        for(char *trg = strtok_r(buffer, ":", &saveptr); trg; trg = strtok_r(NULL, ":", &saveptr)){
+            if(snapshot){
+                note_health_change(src, trg, update_snapshot_status(src, trg, status));
+            } else if(verify){
+                sync_node *entry = find_sync_target(src, trg);
+                if(entry){
+                    entry->errors++;
+                }
+            } else{
+                note_health_change(src, trg, update_target_status(src, trg, status, full_sync));
+            }
+            log_worker_report(src, trg, filename, operation, status, details, pid);
+        }
+    }
+}
+
+
+//add the files a run took from the dedup store and the compressed bytes to the savings of each target 
+static void apply_savings_reports(const char *src, const char *report){
+
+    const char *line = report;
+    while((line = strstr(line, "DEDUP:")) != NULL){
+        char target_dir[PATH_MAX];
+        long files;
+        long long bytes;
+        line += strlen("DEDUP:");
+        if(sscanf(line, "%ld %lld %4095[^\n]", &files, &bytes, target_dir) != 3){
+            continue;
+        }
+        sync_node *entry = find_sync_target(src, target_dir);
+        if(entry){
+            entry->dedup_files += files;
+            entry->dedup_bytes += bytes;
+        }
+        log_and_print("[DEDUP] %s -> %s: %ld files shared, %lld bytes saved", src, target_dir, files, bytes);
+    }
+
+    //COMPRESS lines follow the same pattern: source bytes and the bytes stored for them 
+    line = report;
+    while((line = strstr(line, "COMPRESS:")) != NULL){
+        char target_dir[PATH_MAX];
+        long long raw, stored;
+        line += strlen("COMPRESS:");
+        if(sscanf(line, "%lld %lld %4095[^\n]", &raw, &stored, target_dir) != 3){
+            continue;
+        }
+        sync_node *entry = find_sync_target(src, target_dir);
+        if(entry){
+            entry->compress_raw += raw;
+            entry->compress_stored += stored;
+        }
+        log_and_print("[COMPRESS] %s -> %s: %lld bytes stored as %lld", src, target_dir, raw, stored);
+    }
+}
+
+
+//advance a verify after one slice: queue repairs for the mismatches, then the next slice or finish 
+static void apply_verify_report(const char *src, const char *trg_list, const char *report){
+
+    sync_node *first = find_sync_pair(src);
+    if(!first || !first->verify_running){
+        return;
+    }
+
+    //the target index of a MISMATCH line refers to the target list of the run 
+    char buffer[MAX_TARGETS * PATH_MAX];
+    char *run_targets[MAX_TARGETS];
+    int run_count = 0;
+    strncpy(buffer, trg_list, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+    char *saveptr;
+    for(char *trg = strtok_r(buffer, ":", &saveptr); trg && run_count < MAX_TARGETS; trg = strtok_r(NULL, ":", &saveptr)){
+        run_targets[run_count++] = trg;
+    }
+
+    const char *line = report;
+    while((line = strstr(line, "MISMATCH:")) != NULL){
+        int index;
+        char name[NAME_MAX + 1];
+        line += strlen("MISMATCH:");
+        if(sscanf(line, "%d %255[^\n]", &index, name) != 2 || index < 0 || index >= run_count){
+            continue;
+        }
+        sync_node *entry = find_sync_target(src, run_targets[index]);
+        if(entry){
+            entry->verify_mismatches++;
+        }
+        fprintf(manager_log_file, "[VERIFY] Mismatch: %s/%s on %s, repair queued\n", src, name, run_targets[index]);
+        queue_event_task(src, run_targets[index], name, "MODIFIED");
+    }
+
+    //a slice with more mismatches than its report lists is repaired by a full sync of the target 
+    line = report;
+    while((line = strstr(line, "UNLISTED:")) != NULL){
+        int index, count;
+        line += strlen("UNLISTED:");
+        if(sscanf(line, "%d %d", &index, &count) != 2 || index < 0 || index >= run_count){
+            continue;
+        }
+        sync_node *entry = find_sync_target(src, run_targets[index]);
+        if(entry){
+            entry->verify_mismatches += count;
+        }
+        log_and_print("[VERIFY] %d more mismatches in %s on %s, full sync queued", count, src, run_targets[index]);
+        queue_sync_task(src, run_targets[index]);
+    }
+
+    int done = 0, total = 0, more = 0;
+    char cursor[NAME_MAX + 1] = "";
+    const char *progress = strstr(report, "PROGRESS:");
+    if(!progress || sscanf(progress + strlen("PROGRESS:"), "%d %d %d %255[^\n]", &done, &total, &more, cursor) < 3){
+        //the run failed, try the same slice again later 
+        fflush(manager_log_file);
+        return;
+    }
+
+    for(sync_node *curr = first; curr; curr = next_sync_target(curr)){
+        curr->verify_done = done;
+        curr->verify_total = total;
+        strncpy(curr->verify_cursor, cursor, NAME_MAX);
+        curr->verify_cursor[NAME_MAX] = '\0';
+    }
+
+    if(more && find_active_pair(src)){
+        queue_verify_task(src);
+    } else{
+        time_t now = time(NULL);
+        for(sync_node *curr = first; curr; curr = next_sync_target(curr)){
+            curr->verify_running = 0;
+            strftime(curr->last_verify, sizeof(curr->last_verify), "%F %T", localtime(&now));
+        }
+        log_and_print("[VERIFY] Finished: %s (%d files)", src, done);
+    }
+    save_verify_state();
+}
+
+
+//write the progress of the running verifies so they resume where they stopped after a restart 
+void save_verify_state(){
+
+    char tmp_path[] = VERIFY_STATE_FILE ".tmp";
+    FILE *state = fopen(tmp_path, "w");
+    if(!state){
+        return;
+    }
+    int running_verifies = 0;
+    for(sync_node *curr = sync_list; curr; curr = curr->next){
+        //one line per source, written for its first target 
+        if(curr->verify_running && find_sync_pair(curr->src) == curr){
+            fprintf(state, "%d %d %s\t%s\n", curr->verify_deep, curr->verify_done, curr->src, curr->verify_cursor);
+            running_verifies++;
+        }
+    }
+    fclose(state);
+
+    if(running_verifies == 0){
+        unlink(tmp_path);
+        unlink(VERIFY_STATE_FILE);
+    } else{
+        rename(tmp_path, VERIFY_STATE_FILE);
+    }
+}
+
+
+//resume the verifies that were running when the manager stopped 
+void load_verify_state(){
+
+    FILE *state = fopen(VERIFY_STATE_FILE, "r");
+    if(!state){
+        return;
+    }
+    char line[PATH_MAX + NAME_MAX + 32];
+    while(fgets(line, sizeof(line), state)){
+        int deep, done, consumed = 0;
+        if(sscanf(line, "%d %d %n", &deep, &done, &consumed) != 2 || consumed == 0){
+            continue;
+        }
+        char *src = line + consumed;
+        char *tab = strchr(src, '\t');
+        if(!tab){
+            continue;
+        }
+        *tab = '\0';
+        char *cursor = tab + 1;
+        cursor[strcspn(cursor, "\n")] = '\0';
+
+        if(start_verify(src, deep) != 1){
+            continue;  //no longer monitored 
+        }
+        for(sync_node *curr = find_sync_pair(src); curr; curr = next_sync_target(curr)){
+            curr->verify_done = done;
+            strncpy(curr->verify_cursor, cursor, NAME_MAX);
+            curr->verify_cursor[NAME_MAX] = '\0';
+        }
+        log_and_print("[VERIFY] Resuming: %s after %d files", src, done);
+        queue_verify_task(src);
+    }
+    fclose(state);
+}
+
+
+//deadline of a worker run in microseconds from now (0 = none); a batch gets extra time per file 
+static long long run_timeout_us(const char *filename, const char *operation, int file_count){
+    if(strcmp(operation, "BATCH") == 0){
+        return global_event_timeout > 0 ? global_event_timeout * 1000000LL + file_count * BATCH_TIMEOUT_PER_FILE_MS * 1000LL : 0;
+    }
+    if(strcmp(filename, "ALL") == 0){
+        return global_full_timeout * 1000000LL;
+    }
+    return global_event_timeout * 1000000LL;
+}
+
+
+//start tracking a spawned worker; its report is read from the main loop as it arrives 
+//the trace ids array is owned by the running entry from now on 
+static void track_worker(pid_t pid, int report_fd, const char *src, const char *trg_list, const char *filename, const char *operation, unsigned long *trace_ids, int trace_count, long long spawn_us, int attempt, int file_count){
+
+    fcntl(report_fd, F_SETFD, FD_CLOEXEC);  //later workers must not inherit the pipe 
+
+    running_worker *worker = &running[running_count++];
+    worker->pid = pid;
+    worker->report_fd = report_fd;
+    strncpy(worker->src, src, sizeof(worker->src) - 1);
+    worker->src[sizeof(worker->src) - 1] = '\0';
+    strncpy(worker->trg_list, trg_list, sizeof(worker->trg_list) - 1);
+    worker->trg_list[sizeof(worker->trg_list) - 1] = '\0';
+    strncpy(worker->filename, filename, NAME_MAX);
+    worker->filename[NAME_MAX] = '\0';
+    strncpy(worker->operation, operation, sizeof(worker->operation) - 1);
+    worker->operation[sizeof(worker->operation) - 1] = '\0';
+    worker->report_len = 0;
+    worker->report[0] = '\0';
+    worker->trace_ids = trace_ids;
+    worker->trace_count = trace_count;
+    worker->spawn_us = spawn_us;
+    worker->attempt = attempt;
+    long long timeout_us = run_timeout_us(filename, operation, file_count);
+    worker->deadline_us = timeout_us > 0 ? spawn_us + timeout_us : 0;
+    worker->kill_us = 0;
+    worker->timed_out = 0;
+    worker->only_trg[0] = '\0';
+    worker->limit_fd = -1;
+    worker->bw_limit = 0;
+    worker->file_limit = 0;
+}
+
+
+//check whether a worker is already running for a source 
+static int source_busy(const char *src){
+    for(int i = 0; i < running_count; i++){
+        if(strcmp(running[i].src, src) == 0){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+//schedule another attempt for the parts of a finished run that failed 
+static void queue_retries(running_worker *worker, const char *status){
+
+    int attempt = worker->attempt + 1;
+
+    //a verify slice without progress is run again; mismatches are repaired by their own events 
+    if(strncmp(worker->operation, "VERIFY", 6) == 0){
+        if(!strstr(worker->report, "PROGRESS:")){
+            schedule_retry(worker->src, "", "ALL", worker->operation, attempt);
+        }
+        return;
+    }
+
+    //a single event is retried on the targets of its run 
+    if(strcmp(worker->filename, "ALL") != 0){
+        if(strcmp(status, "SUCCESS") != 0){
+            schedule_retry(worker->src, worker->only_trg, worker->filename, worker->operation, attempt);
+        }
+        return;
+    }
+
+    //a batch lists its failed entries; when the list is missing or incomplete a full sync catches up 
+    if(strcmp(worker->operation, "BATCH") == 0){
+        int listed = 0, failed = 0;
+        const char *line = worker->report;
+        while((line = strstr(line, "FAILED:")) != NULL){
+            char operation[16], name[NAME_MAX + 1];
+            line += strlen("FAILED:");
+            if(sscanf(line, "%15s %255[^\n]", operation, name) == 2){
+                schedule_retry(worker->src, worker->only_trg, name, operation, attempt);
+                listed++;
+            }
+        }
+        const char *details = strstr(worker->report, "DETAILS:");
+        if(details){
+            sscanf(details + strlen("DETAILS:"), "%*d files processed, %d failed", &failed);
+        }
+        if(strcmp(status, "SUCCESS") != 0 && (listed == 0 || failed > listed)){
+            schedule_retry(worker->src, worker->only_trg, "ALL", "FULL", attempt);
+        }
+        return;
+    }
+
+    //full syncs and snapshots are retried for the targets that failed 
+    const char *operation = strcmp(worker->operation, "SNAPSHOT") == 0 ? "SNAPSHOT" : "FULL";
+    int reported = 0;
+    const char *line = worker->report;
+    while((line = strstr(line, "TARGET:")) != NULL){
+        char target_status[32], target_dir[PATH_MAX];
+        line += strlen("TARGET:");
+        if(sscanf(line, "%31s %*d %*d %*d %4095[^\n]", target_status, target_dir) != 2){
+            continue;
+        }
+        reported++;
+        if(strcmp(target_status, "SUCCESS") != 0){
+            schedule_retry(worker->src, target_dir, "ALL", operation, attempt);
+        }
+    }
+    if(reported == 0 && strcmp(status, "SUCCESS") != 0){
+        schedule_retry(worker->src, "", "ALL", operation, attempt);
+    }
+}
+
+
+//apply the complete report of a worker that closed its output and release its slot 
+static void finish_worker(int slot){
+
+    running_worker *worker = &running[slot];
+    char status_clean[32];
+    char details_clean[1024];
+    if(worker->timed_out){
+        //whatever a killed worker wrote is incomplete, the whole run counts as failed 
+        worker->report_len = 0;
+        worker->report[0] = '\0';
+        strcpy(status_clean, "TIMEOUT");
+        snprintf(details_clean, sizeof(details_clean), "Killed after its deadline of %lld s", (worker->deadline_us - worker->spawn_us) / 1000000);
+    } else{
+        parse_worker_report(worker->report, worker->report_len, status_clean, details_clean);
+    }
+    apply_target_reports(worker->src, worker->trg_list, worker->filename, worker->operation, worker->report, status_clean, details_clean, worker->pid);
+    apply_savings_reports(worker->src, worker->report);
+    if(strncmp(worker->operation, "VERIFY", 6) == 0){
+        apply_verify_report(worker->src, worker->trg_list, worker->report);
+    }
+    queue_retries(worker, status_clean);
+
+    //feed the measured work to the concurrency controller 
+    long long bytes = 0;
+    long files = 0;
+    char *work = strstr(worker->report, "WORK:");
+    if(work){
+        sscanf(work + strlen("WORK:"), "%lld %ld", &bytes, &files);
+    }
+    autoscale_record(bytes, files);
+
+    //worker side stages: fork/exec until the worker started, its work, and the report handling here 
+    long long started_us = 0, ended_us = 0;
+    char *trace = strstr(worker->report, "TRACE:");
+    if(trace){
+        sscanf(trace + strlen("TRACE:"), "%*s %lld %lld", &started_us, &ended_us);
+    }
+    long long now_us = trace_now_us();
+    for(int i = 0; i < worker->trace_count; i++){
+        unsigned long id = worker->trace_ids[i];
+        if(started_us > 0){
+            trace_span(id, "spawn", worker->spawn_us, started_us, NULL);
+            trace_span(id, "worker", started_us, ended_us, NULL);
+            trace_span(id, "report", ended_us, now_us, NULL);
+        } else{
+            trace_span(id, "worker", worker->spawn_us, now_us, NULL);
+        }
+    }
+    free(worker->trace_ids);
+
+    close(worker->report_fd);
+    if(worker->limit_fd >= 0){
+        close(worker->limit_fd);
+    }
+    running[slot] = running[--running_count];
+}
+
+
+//terminate the workers that passed their deadline: SIGTERM first, SIGKILL after KILL_GRACE_MS 
+//(returns the milliseconds until the next deadline, -1 if no worker has one)
+int check_worker_deadlines(){
+
+    long long now = trace_now_us();
+    long long next = 0;
+    for(int i = 0; i < running_count; i++){
+        running_worker *worker = &running[i];
+        if(worker->deadline_us == 0){
+            continue;
+        }
+        if(!worker->timed_out && now >= worker->deadline_us){
+            kill(worker->pid, SIGTERM);
+            worker->timed_out = 1;
+            worker->kill_us = now + KILL_GRACE_MS * 1000LL;
+            log_and_print("[TIMEOUT] Worker %d (%s %s) passed its deadline, terminating", worker->pid, worker->operation, worker->src);
+        } else if(worker->timed_out && worker->kill_us > 0 && now >= worker->kill_us){
+            //the slot is released now, even if something still holds the report pipe open 
+            kill(worker->pid, SIGKILL);
+            log_and_print("[TIMEOUT] Worker %d did not stop, killed", worker->pid);
+            finish_worker(i--);
+            continue;
+        }
+
+        long long due = worker->timed_out ? worker->kill_us : worker->deadline_us;
+        if(due > 0 && (next == 0 || due < next)){
+            next = due;
+        }
+    }
+    if(next == 0){
+        return -1;
+    }
+    return next > now ? (int)((next - now) / 1000) + 1 : 0;
+}
+
+
+//fill poll entries for the report pipes of the running workers (returns how many were added)
+int worker_poll_fds(struct pollfd *fds, int max){
+    int count = 0;
+    for(int i = 0; i < running_count && count < max; i++){
+        fds[count].fd = running[i].report_fd;
+        fds[count].events = POLLIN;
+        fds[count].revents = 0;
+        count++;
+    }
+    return count;
+}
+
+
+//read what the running workers wrote and finish the ones that closed their output 
+void handle_worker_output(struct pollfd *fds, int count){
+
+    for(int k = 0; k < count; k++){
+        if(!(fds[k].revents & (POLLIN | POLLHUP | POLLERR))){
+            continue;
+        }
+        int slot;
+        for(slot = 0; slot < running_count && running[slot].report_fd != fds[k].fd; slot++);
+        if(slot == running_count){
+            continue;
+        }
+
+        running_worker *worker = &running[slot];
+        char discard[4096];
+        char *buffer = discard;
+        size_t room = sizeof(discard);
+        if(worker->report_len < sizeof(worker->report) - 1){
+            buffer = worker->report + worker->report_len;
+            room = sizeof(worker->report) - 1 - worker->report_len;
+        }
+
+        //anything beyond the report buffer is drained and dropped so the worker never blocks 
+        ssize_t bytes = read(worker->report_fd, buffer, room);
+        if(bytes < 0 && (errno == EINTR || errno == EAGAIN)){
+            continue;
+        }
+        if(bytes > 0){
+            if(buffer != discard){
+                worker->report_len += bytes;
+                worker->report[worker->report_len] = '\0';
+            }
+            continue;
+        }
+        finish_worker(slot);
+    }
+}
+
+
+//block until every running worker has finished and its report was applied (used on shutdown)
+void wait_running_workers(){
+
+    struct pollfd fds[MAX_RUNNING_WORKERS];
+    while(running_count > 0){
+        int count = worker_poll_fds(fds, MAX_RUNNING_WORKERS);
+        if(poll(fds, count, check_worker_deadlines()) == -1 && errno != EINTR){
+            perror("poll");
+            return;
+        }
+        handle_worker_output(fds, count);
+    }
+}
+
+
+//create the shared status table (returns -1 if it cannot be created; status then only works through the console)
+int open_status_table(){
+    status_shm = status_create();
+    return status_shm ? 0 : -1;
+}
+
+
+//remove the shared status table, readers then see that no manager is running 
+void close_status_table(){
+    status_destroy(status_shm);
+    status_shm = NULL;
+}
+
+
+//copy the state of every pair into the shared status table, at most once per STATUS_PUBLISH_MS 
+//(returns the milliseconds until a skipped refresh is due, -1 when the table is current)
+int publish_status(){
+
+    if(!status_shm){
+        return -1;
+    }
+    long long now = trace_now_us();
+    if(now - status_published_us < STATUS_PUBLISH_MS * 1000LL){
+        return (int)((STATUS_PUBLISH_MS * 1000LL - (now - status_published_us)) / 1000) + 1;
+    }
+    status_published_us = now;
+
+    //queue and worker counts are kept on the first target of each source 
+    for(sync_node *curr = sync_list; curr; curr = curr->next){
+        curr->queued = 0;
+        curr->running = 0;
+    }
+    for(int i = queue_start; i != queue_end; i = (i + 1) % MAX_QUEUE){
+        sync_node *first = find_sync_pair(workers_queue[i].src_path);
+        if(first){
+            first->queued++;
+        }
+    }
+    for(int i = 0; i < running_count; i++){
+        sync_node *first = find_sync_pair(running[i].src);
+        if(first){
+            first->running = 1;
+        }
+    }
+
+    //a pair keeps its slot, entries that did not change are not touched 
+    static int used_slots = 0;
+    int dropped = 0;
+    for(sync_node *curr = sync_list; curr; curr = curr->next){
+        if(curr->status_slot < 0){
+            if(used_slots == STATUS_MAX_ENTRIES){
+                dropped++;
+                continue;
+            }
+            curr->status_slot = used_slots++;
+        }
+        status_entry entry;
+        fill_status_entry(curr, &entry);
+        status_write_entry(status_shm, curr->status_slot, &entry);
     }
 
-    time_t now = time(NULL);
-    char ts[64];
-    strftime(ts, sizeof(ts), "%F %T", localtime(&now));
-    fprintf(manager_log_file, "[%s] %s\n", ts, msg);
-    fflush(manager_log_file);
+    status_summary summary;
+    summary.manager_pid = getpid();
+    summary.updated = time(NULL);
+    summary.count = used_slots;
+    summary.dropped = dropped;
+    summary.queue_depth = (queue_end - queue_start + MAX_QUEUE) % MAX_QUEUE;
+    summary.running_workers = running_count;
+    summary.worker_limit = autoscale_limit();
+    status_write_summary(status_shm, &summary);
+    return -1;
 }
 
 
-//print a message to stdout and log it to the manager log file 
-void log_and_print(const char *format, ...){
-    va_list args1;
-    va_list args2;
-    va_start(args1, format);
-    va_copy(args2, args1);
-
-    vprintf(format, args1);
-    printf("\n");
+//check whether any task is queued or any worker is running 
+int workers_busy(){
+    return running_count > 0 || queue_start != queue_end;
+}
 
-    vfprintf(manager_log_file, format, args2);
-    fprintf(manager_log_file, "\n");
 
-    fflush(manager_log_file);
-    va_end(args1);
-    va_end(args2);
+//remove one task from the queue, keeping the others in order 
+static void remove_task(int index){
+    for(int i = index; (i + 1) % MAX_QUEUE != queue_end; i = (i + 1) % MAX_QUEUE){
+        workers_queue[i] = workers_queue[(i + 1) % MAX_QUEUE];
+    }
+    queue_end = (queue_end - 1 + MAX_QUEUE) % MAX_QUEUE;
 }
 
 
-//signal handler for SIGCHLD: called when a child process terminates 
-void child_signal_handler(int signal_number){
+//start a FULL, MIRROR, SNAPSHOT or VERIFY run for a task, writing to all selected targets in one pass
+static void run_full_task(worker_task *task){
 
-    while(waitpid(-1, NULL, WNOHANG) > 0){
-        active_workers--;
+    char trg_list[MAX_TARGETS * PATH_MAX];
+    char mirror_mask[64];
+    if(collect_targets(task->src_path, task->trg_path, trg_list, sizeof(trg_list), mirror_mask, sizeof(mirror_mask)) == 0){
+        fprintf(manager_log_file, "[QUEUE] No active target for: %s\n", task->src_path);
+        fflush(manager_log_file);
+        return;
     }
-    worker_done = 1;
-}
 
+    //mirror targets also prune files missing from source 
+    const char *operation = mirror_mask[0] != '\0' ? "MIRROR" : "FULL";
+    if(strcmp(task->operation, "SNAPSHOT") == 0 || strncmp(task->operation, "VERIFY", 6) == 0){
+        operation = task->operation;
+        mirror_mask[0] = '\0';
+    }
 
-//add a new sync task to the workers queue
-void queue_sync_task(const char *source_path, const char *target_path){
+    char label[TRACE_LABEL_LEN];
+    snprintf(label, sizeof(label), "%.10s %.100s", operation, task->src_path);
+    long long spawn_us = trace_now_us();
+    trace_span(task->trace_id, "queue", task->queued_us, spawn_us, label);
 
-    if((queue_end + 1) % MAX_QUEUE == queue_start){
-        fprintf(manager_log_file, "[QUEUE] Full. Task dropped: %s -> %s\n", source_path, target_path);
+    int report_fd, limit_fd;
+    pid_t worker_pid = spawn_worker(task->src_path, trg_list, "ALL", operation, mirror_mask, &limit_fd, task->trace_id, &report_fd, -1);
+    if(worker_pid < 0){
+        schedule_retry(task->src_path, task->trg_path, "ALL", task->operation, task->attempt + 1);
         return;
     }
+    unsigned long *trace_ids = malloc(sizeof(unsigned long));
+    if(trace_ids){
+        trace_ids[0] = task->trace_id;
+    }
+    track_worker(worker_pid, report_fd, task->src_path, trg_list, "ALL", operation, trace_ids, trace_ids ? 1 : 0, spawn_us, task->attempt, 1);
 
-    strncpy(workers_queue[queue_end].src_path, source_path, PATH_MAX);
-    strncpy(workers_queue[queue_end].trg_path, target_path, PATH_MAX);
-    queue_end = (queue_end + 1) % MAX_QUEUE;
+    //remember what the worker was started with, later changes are pushed by push_worker_limits 
+    running_worker *worker = &running[running_count - 1];
+    worker->limit_fd = limit_fd;
+    throttle_limits(task->src_path, operation, throttled_workers(), &worker->bw_limit, &worker->file_limit);
 
-    fprintf(manager_log_file, "[QUEUE] Task queued: %s -> %s\n", source_path, target_path);
+    fprintf(manager_log_file, "[SPAWN] Worker for: %s -> %s\n", task->src_path, trg_list);
     fflush(manager_log_file);
 }
 
 
-//start worker processes from the queue if possible 
-void dispatch_workers(int output_fd){
+//group every queued event of the pair at index first (up to its next full sync) into one worker run 
+static void run_event_tasks(int first){
 
-    while(active_workers < MAX_WORKERS && queue_start != queue_end){
-        worker_task *current_task = &workers_queue[queue_start];
+    static int picked[MAX_QUEUE];
+    static char taken[MAX_QUEUE];
+    int picked_count = 0;
 
-        int pipe_fd[2];
-        if(pipe(pipe_fd) == -1){
-            perror("pipe");
-            return;
-        }
+    char src[PATH_MAX], only_trg[PATH_MAX];
+    strncpy(src, workers_queue[first].src_path, PATH_MAX);
+    strncpy(only_trg, workers_queue[first].trg_path, PATH_MAX);  //verify repairs name one target, other events have none 
 
-        pid_t worker_pid = fork();
+    for(int i = queue_start; i != queue_end; i = (i + 1) % MAX_QUEUE){
+        taken[i] = 0;
+    }
 
-        if(worker_pid < 0){
-            perror("fork failed");
-            exit(1);
+    //earlier tasks of this source were already started, so the scan can begin at first 
+    for(int i = first; i != queue_end; i = (i + 1) % MAX_QUEUE){
+        worker_task *task = &workers_queue[i];
+        if(strcmp(task->src_path, src) != 0){
+            continue;
         }
-
-        if(worker_pid == 0){
-            //child process: set up stdout and exec worker 
-            close(pipe_fd[0]);  //close read
-            dup2(pipe_fd[1], STDOUT_FILENO); 
-            close(pipe_fd[1]);
-            execl("bin/worker", "worker", current_task->src_path, current_task->trg_path, "ALL", "FULL", NULL);
-            perror("execl failed");
-            exit(1);
+        if(strcmp(task->filename, "ALL") == 0 || strcmp(task->trg_path, only_trg) != 0){
+            break;  //later events must not overtake a queued full sync or events for other targets 
         }
 
-        //parent process
-        close(pipe_fd[1]);  //close write
-        active_workers++;
+        taken[i] = 1;
 
-        char buffer[1024];
-        ssize_t bytes = read(pipe_fd[0], buffer, sizeof(buffer) - 1);
-        close(pipe_fd[0]);
+        //only the latest event per file matters 
+        int k;
+        for(k = 0; k < picked_count; k++){
+            if(strcmp(workers_queue[picked[k]].filename, task->filename) == 0){
+                picked[k] = i;
+                break;
+            }
+        }
+        if(k == picked_count){
+            picked[picked_count++] = i;
+        }
+    }
 
-        char status_clean[32] = "UNKNOWN";
-        char details_clean[1024] = "No details";
-        
-        if(bytes > 0){
-            buffer[bytes] = '\0';
+    int report_fd;
+    pid_t worker_pid;
 
-            char *status = strstr(buffer, "STATUS:");
-            char *details = strstr(buffer, "DETAILS:");
+    //every taken event (also the ones superseded by a later event of the same file) is traced through this run 
+    long long spawn_us = trace_now_us();
+    int trace_count = 0;
+    unsigned long *trace_ids = malloc(MAX_QUEUE * sizeof(unsigned long));
+    for(int i = queue_start; i != queue_end; i = (i + 1) % MAX_QUEUE){
+        if(taken[i]){
+            trace_span(workers_queue[i].trace_id, "queue", workers_queue[i].queued_us, spawn_us, NULL);
+            if(trace_ids){
+                trace_ids[trace_count++] = workers_queue[i].trace_id;
+            }
+        }
+    }
+
+    //events are applied to every active target of the source, repairs only to the target that mismatched 
+    char trg_list[MAX_TARGETS * PATH_MAX];
+    char mirror_mask[64];
+    if(collect_targets(src, only_trg, trg_list, sizeof(trg_list), mirror_mask, sizeof(mirror_mask)) == 0){
+        picked_count = 0;  //pair cancelled meanwhile, just drop its events 
+    }
 
-            if(status){
-                status += strlen("STATUS:");
-                sscanf(status, "%31s", status_clean);
+    worker_pid = 0;
+    if(picked_count == 1){
+        worker_task *task = &workers_queue[picked[0]];
+        worker_pid = spawn_worker(src, trg_list, task->filename, task->operation, NULL, NULL, task->trace_id, &report_fd, -1);
+        if(worker_pid >= 0){
+            track_worker(worker_pid, report_fd, src, trg_list, task->filename, task->operation, trace_ids, trace_count, spawn_us, task->attempt, 1);
+            strcpy(running[running_count - 1].only_trg, only_trg);
+            trace_ids = NULL;
+        }
+    } else if(picked_count > 1){
+        //the list goes into an unlinked temporary file that becomes the worker's stdin, 
+        //so a long list never blocks the manager on a full pipe 
+        FILE *input = tmpfile();
+        worker_pid = -1;
+        if(!input){
+            perror("tmpfile");
+        } else{
+            for(int k = 0; k < picked_count; k++){
+                fprintf(input, "%s %s\n", workers_queue[picked[k]].operation, workers_queue[picked[k]].filename);
+            }
+            if(fflush(input) == 0 && fseek(input, 0, SEEK_SET) == 0){
+                worker_pid = spawn_worker(src, trg_list, "-", "BATCH", NULL, NULL, workers_queue[picked[0]].trace_id, &report_fd, fileno(input));
+            } else{
+                perror("tmpfile");
             }
-            if(details){
-                details += strlen("DETAILS:");
-                sscanf(details, "%1023[^\n]", details_clean);
+            fclose(input);
+        }
+        if(worker_pid >= 0){
+            int attempt = 0;
+            for(int k = 0; k < picked_count; k++){
+                if(workers_queue[picked[k]].attempt > attempt){
+                    attempt = workers_queue[picked[k]].attempt;
+                }
             }
+            track_worker(worker_pid, report_fd, src, trg_list, "ALL", "BATCH", trace_ids, trace_count, spawn_us, attempt, picked_count);
+            strcpy(running[running_count - 1].only_trg, only_trg);
+            trace_ids = NULL;
+        }
+    }
+    free(trace_ids);
+
+    //events whose worker could not be started go to the retry list instead of being lost 
+    if(worker_pid < 0){
+        fprintf(manager_log_file, "[SPAWN] Could not start a worker for %s, %d events will be retried\n", src, picked_count);
+        for(int k = 0; k < picked_count; k++){
+            worker_task *task = &workers_queue[picked[k]];
+            schedule_retry(src, only_trg, task->filename, task->operation, task->attempt + 1);
+        }
+        fflush(manager_log_file);
+    }
+
+    //drop the handled events and keep the rest of the queue in order 
+    int write_pos = queue_start;
+    for(int i = queue_start; i != queue_end; i = (i + 1) % MAX_QUEUE){
+        if(taken[i]){
+            continue;
+        }
+        if(write_pos != i){
+            workers_queue[write_pos] = workers_queue[i];
+        }
+        write_pos = (write_pos + 1) % MAX_QUEUE;
+    }
+    queue_end = write_pos;
+}
+
+
+//send new limits to the running background syncs after a throttle command, a reload or a change in the number 
+//of background syncs sharing the global budget; the worker reads the last line of its pipe when SIGUSR1 arrives 
+static void push_worker_limits(){
+
+    for(int i = 0; i < running_count; i++){
+        running_worker *worker = &running[i];
+        if(worker->limit_fd < 0){
+            continue;
+        }
+
+        long bw, files;
+        throttle_limits(worker->src, worker->operation, throttled_workers(), &bw, &files);
+        if(bw == worker->bw_limit && files == worker->file_limit){
+            continue;
+        }
+
+        //a write fails once the worker has exited, so no signal goes to a reused pid 
+        char line[64];
+        int length = snprintf(line, sizeof(line), "%ld %ld\n", bw, files);
+        if(write(worker->limit_fd, line, length) == length){
+            kill(worker->pid, SIGUSR1);
+            worker->bw_limit = bw;
+            worker->file_limit = files;
+            fprintf(manager_log_file, "[THROTTLE] Worker %d for %s now limited to %ld bytes/s, %ld files/s\n", worker->pid, worker->src, bw, files);
+            fflush(manager_log_file);
+        }
+    }
+}
+
+
+//start worker processes from the queue while the current concurrency limit allows 
+//tasks of a source that already has a running worker wait, so the changes of one source stay in order 
+void dispatch_workers(int output_fd){
+
+    promote_retries();
+    int queued = (queue_end - queue_start + MAX_QUEUE) % MAX_QUEUE;
+    autoscale_tick(queued, running_count);
+
+    int i = queue_start;
+    while(running_count < autoscale_limit() && i != queue_end){
+        worker_task *task = &workers_queue[i];
+        if(source_busy(task->src_path)){
+            i = (i + 1) % MAX_QUEUE;
+            continue;
+        }
+
+        //both runs remove the started tasks, so the next candidate moves into index i 
+        if(strcmp(task->filename, "ALL") == 0){
+            worker_task current = *task;
+            remove_task(i);
+            run_full_task(&current);
+        } else{
+            run_event_tasks(i);
+        }
+    }
+
+    //the share of every background sync follows how many of them run and the current limits 
+    push_worker_limits();
+}
+
+
+//apply settings shared by all pairs: bwlimit=, filelimit=, parallel_threshold=, copy_threads=, bulk_threshold=, startup_wave=, event_timeout=, full_timeout= (returns 0 on success, -1 on unknown option)
+int apply_global_options(const char *options){
+
+    char buffer[512];
+    strncpy(buffer, options, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+
+    int result = 0;
+    char *saveptr;
+    char *token = strtok_r(buffer, " \t\n", &saveptr);
+    while(token){
+        if(strncmp(token, "bwlimit=", 8) == 0 && parse_rate(token + 8) >= 0){
+            global_bw_limit = parse_rate(token + 8);
+        } else if(strncmp(token, "filelimit=", 10) == 0 && parse_rate(token + 10) >= 0){
+            global_file_limit = parse_rate(token + 10);
+        } else if(strncmp(token, "parallel_threshold=", 19) == 0 && parse_rate(token + 19) >= 0){
+            global_parallel_threshold = parse_rate(token + 19);
+        } else if(strncmp(token, "copy_threads=", 13) == 0 && atoi(token + 13) > 0){
+            global_copy_threads = atoi(token + 13);
+        } else if(strncmp(token, "bulk_threshold=", 15) == 0 && parse_rate(token + 15) >= 0){
+            global_bulk_threshold = parse_rate(token + 15);
+        } else if(strncmp(token, "startup_wave=", 13) == 0 && atoi(token + 13) > 0){
+            startup_wave = atoi(token + 13);
+        } else if(strncmp(token, "scrub_bwlimit=", 14) == 0 && parse_rate(token + 14) >= 0){
+            global_scrub_bw_limit = parse_rate(token + 14);
+        } else if(strncmp(token, "event_timeout=", 14) == 0 && parse_interval(token + 14) >= 0){
+            global_event_timeout = parse_interval(token + 14);
+        } else if(strncmp(token, "full_timeout=", 13) == 0 && parse_interval(token + 13) >= 0){
+            global_full_timeout = parse_interval(token + 13);
         } else{
-            strcpy(status_clean, "FAIL");
-            strcpy(details_clean, "No output from worker");
+            result = -1;
         }
+        token = strtok_r(NULL, " \t\n", &saveptr);
+    }
+    return result;
+}
 
-        log_worker_report(current_task->src_path, current_task->trg_path, "ALL", "FULL", status_clean, details_clean, worker_pid);
 
-        fprintf(manager_log_file, "[SPAWN] Worker for: %s -> %s\n", current_task->src_path, current_task->trg_path);
-        fflush(manager_log_file);
-        queue_start = (queue_start + 1) % MAX_QUEUE;
-        
+//one line of the config file, parsed and validated by a loader thread 
+typedef struct{
+    char *line;
+    int kind;  //CONFIG_SKIP, CONFIG_PAIR or CONFIG_GLOBAL
+    int valid;  //both directories exist 
+    int consumed;  //where the pair options start 
+    char source_path[256];
+    char target_path[256];
+}config_entry;
+
+#define CONFIG_SKIP 0
+#define CONFIG_PAIR 1
+#define CONFIG_GLOBAL 2
+#define CONFIG_LINES_PER_THREAD 256
+#define CONFIG_MAX_THREADS 8
+
+
+//range of config entries handled by one loader thread 
+typedef struct{
+    config_entry *entries;
+    int start;
+    int end;
+}config_range;
+
+
+//parse and validate a range of config lines (runs in a loader thread)
+static void *parse_config_range(void *arg){
+    config_range *range = arg;
+
+    for(int i = range->start; i < range->end; i++){
+        config_entry *entry = &range->entries[i];
+        entry->kind = CONFIG_SKIP;
+
+        //global settings line: global bwlimit=<bytes/s> filelimit=<files/s>
+        if(strncmp(entry->line, "global", 6) == 0 && (entry->line[6] == '\0' || isspace((unsigned char)entry->line[6]))){
+            entry->kind = CONFIG_GLOBAL;
+            continue;
+        }
+
+        if(sscanf(entry->line, "%255s %255s%n", entry->source_path, entry->target_path, &entry->consumed) == 2){
+            struct stat src_st, trg_st;
+            entry->kind = CONFIG_PAIR;
+            entry->valid = stat(entry->source_path, &src_st) == 0 && S_ISDIR(src_st.st_mode) &&
+                           stat(entry->target_path, &trg_st) == 0 && S_ISDIR(trg_st.st_mode);
+        }
     }
+    return NULL;
 }
 
 
-//load initial sync pairs from configuration file 
-void load_config(const char *filename){
+//read a config file and parse and validate its lines in parallel (returns the entries, NULL if the file cannot be read)
+//the entries point into *content, both are freed by the caller 
+static config_entry *parse_config(const char *filename, int *count_out, char **content_out){
 
     FILE *config_file = fopen(filename, "r");
     if(!config_file){
+        return NULL;
+    }
+
+    //read the whole file and split it into lines 
+    char *content = NULL;
+    size_t content_size = 0;
+    char chunk[65536];
+    size_t bytes;
+    while((bytes = fread(chunk, 1, sizeof(chunk), config_file)) > 0){
+        char *grown = realloc(content, content_size + bytes + 1);
+        if(!grown){
+            perror("realloc");
+            exit(1);
+        }
+        content = grown;
+        memcpy(content + content_size, chunk, bytes);
+        content_size += bytes;
+    }
+    fclose(config_file);
+    if(!content){
+        content = strdup("");
+        if(!content){
+            return NULL;
+        }
+    }
+    content[content_size] = '\0';
+
+    int line_count = 0;
+    for(size_t i = 0; i < content_size; i++){
+        line_count += (content[i] == '\n');
+    }
+    line_count++;
+
+    config_entry *entries = calloc(line_count, sizeof(config_entry));
+    if(!entries){
+        perror("calloc");
+        exit(1);
+    }
+    int count = 0;
+    char *saveptr;
+    for(char *line = strtok_r(content, "\n", &saveptr); line; line = strtok_r(NULL, "\n", &saveptr)){
+        entries[count++].line = line;
+    }
+
+    //parse and validate the lines with several threads 
+    int thread_count = count / CONFIG_LINES_PER_THREAD + 1;
+    if(thread_count > CONFIG_MAX_THREADS){
+        thread_count = CONFIG_MAX_THREADS;
+    }
+    pthread_t threads[CONFIG_MAX_THREADS];
+    config_range ranges[CONFIG_MAX_THREADS];
+    int per_thread = (count + thread_count - 1) / thread_count;
+    for(int t = 0; t < thread_count; t++){
+        ranges[t].entries = entries;
+        ranges[t].start = t * per_thread < count ? t * per_thread : count;
+        ranges[t].end = (t + 1) * per_thread < count ? (t + 1) * per_thread : count;
+        if(pthread_create(&threads[t], NULL, parse_config_range, &ranges[t]) != 0){
+            parse_config_range(&ranges[t]);
+            threads[t] = 0;
+        }
+    }
+    for(int t = 0; t < thread_count; t++){
+        if(threads[t]){
+            pthread_join(threads[t], NULL);
+        }
+    }
+
+    *count_out = count;
+    *content_out = content;
+    return entries;
+}
+
+
+//reset the settings of a "global" line to their defaults 
+static void reset_global_options(){
+    global_bw_limit = 0;
+    global_file_limit = 0;
+    global_parallel_threshold = 0;
+    global_copy_threads = 0;
+    global_bulk_threshold = -1;
+    startup_wave = INITIAL_SYNC_WAVE;
+    global_scrub_bw_limit = 0;
+    global_event_timeout = DEFAULT_EVENT_TIMEOUT;
+    global_full_timeout = DEFAULT_FULL_TIMEOUT;
+}
+
+
+//load initial sync pairs from configuration file 
+//lines are parsed and validated in parallel, then registered in file order; full syncs are started later in waves
+void load_config(const char *filename){
+
+    int count;
+    char *content;
+    config_entry *entries = parse_config(filename, &count, &content);
+    if(!entries){
         perror("Failed to open config file");
         exit(1);
     }
 
-    char source_path[256];
-    char target_path[256];
-    char line[512];
-    while(fgets(line, sizeof(line), config_file)){
-        if(sscanf(line, "%s %s", source_path, target_path) == 2){
-            if(add_sync_pair(source_path, target_path) == 1){
-                queue_sync_task(source_path, target_path);
-                add_watch(source_path); 
-                fprintf(manager_log_file, "[CONFIG] Loaded pair: %s -> %s\n", source_path, target_path);
-            } else{
-                fprintf(manager_log_file, "[CONFIG] Skipped duplicate: %s -> %s\n", source_path, target_path);
+    //register the pairs in file order; registry lookups are hashed 
+    for(int i = 0; i < count; i++){
+        config_entry *entry = &entries[i];
+
+        if(entry->kind == CONFIG_GLOBAL){
+            if(apply_global_options(entry->line + 6) != 0){
+                fprintf(manager_log_file, "[CONFIG] Unknown global option ignored: %s\n", entry->line);
+            }
+            continue;
+        }
+        if(entry->kind != CONFIG_PAIR){
+            continue;
+        }
+        if(!entry->valid){
+            fprintf(manager_log_file, "[CONFIG] Skipped missing directory: %s -> %s\n", entry->source_path, entry->target_path);
+            continue;
+        }
+
+        if(add_sync_pair(entry->source_path, entry->target_path) == 1){
+            sync_node *pair = find_sync_target(entry->source_path, entry->target_path);
+            if(apply_pair_options(pair, entry->line + entry->consumed) != 0){
+                fprintf(manager_log_file, "[CONFIG] Unknown option ignored: %s\n", entry->line);
             }
+            pair->initial_pending = 1;
+            pair->watch_pending = 1;  //registered in batches from the main loop 
+            fprintf(manager_log_file, "[CONFIG] Loaded pair: %s -> %s\n", entry->source_path, entry->target_path);
+        } else{
+            fprintf(manager_log_file, "[CONFIG] Skipped duplicate: %s -> %s\n", entry->source_path, entry->target_path);
         }
     }
 
-    fclose(config_file);
+    free(entries);
+    free(content);
+    initial_cursor = sync_list;
+    watch_cursor = sync_list;
     fflush(manager_log_file);
 }
 
 
+//re-read the config file and apply only the difference to the registry (returns -1 if the file cannot be read)
+//new pairs are started, pairs missing from the file are stopped, unchanged pairs keep their watches, queue and history 
+int reload_config(const char *filename, int *added_out, int *removed_out, int *kept_out){
+
+    int count;
+    char *content;
+    config_entry *entries = parse_config(filename, &count, &content);
+    if(!entries){
+        return -1;
+    }
+
+    int added = 0, removed = 0, kept = 0;
+    for(sync_node *curr = sync_list; curr; curr = curr->next){
+        curr->seen = 0;
+    }
+
+    reset_global_options();
+    for(int i = 0; i < count; i++){
+        config_entry *entry = &entries[i];
+
+        if(entry->kind == CONFIG_GLOBAL){
+            apply_global_options(entry->line + 6);
+            continue;
+        }
+        if(entry->kind != CONFIG_PAIR || !entry->valid){
+            continue;
+        }
+
+        sync_node *pair = find_sync_target(entry->source_path, entry->target_path);
+        if(pair && pair->active){
+            //unchanged pair: refresh its options only 
+            if(!pair->seen){
+                reset_pair_options(pair);
+                apply_pair_options(pair, entry->line + entry->consumed);
+                pair->seen = 1;
+                kept++;
+            }
+            continue;
+        }
+
+        //new or previously stopped pair 
+        if(!pair){
+            if(add_sync_pair(entry->source_path, entry->target_path) != 1){
+                continue;
+            }
+            pair = find_sync_target(entry->source_path, entry->target_path);
+        } else{
+            pair->active = 1;
+        }
+        reset_pair_options(pair);
+        apply_pair_options(pair, entry->line + entry->consumed);
+        pair->seen = 1;
+        pair->initial_pending = 1;
+        pair->watch_pending = 1;
+        log_and_print("[RELOAD] Added pair: %s -> %s", entry->source_path, entry->target_path);
+        added++;
+    }
+
+    //stop the pairs that are no longer in the file 
+    for(sync_node *curr = sync_list; curr; curr = curr->next){
+        if(curr->active && !curr->seen){
+            curr->active = 0;
+            curr->initial_pending = 0;
+            curr->watch_pending = 0;
+            log_and_print("[RELOAD] Removed pair: %s -> %s", curr->src, curr->trg);
+            removed++;
+            if(!find_active_pair(curr->src)){
+                monitor_remove_watch(curr->src);
+            }
+        }
+    }
+
+    free(entries);
+    free(content);
+
+    //new pairs get their watch and initial full sync from the main loop 
+    initial_cursor = sync_list;
+    watch_cursor = sync_list;
+
+    *added_out = added;
+    *removed_out = removed;
+    *kept_out = kept;
+    return 0;
+}
+
+
+//register the next WATCH_BATCH sources of loaded pairs with the monitor, so a large config does not hold up 
+//console commands and events until every watch exists (returns 1 while sources are still waiting)
+int register_pending_watches(){
+
+    const char *batch[WATCH_BATCH];
+    int count = 0;
+
+    while(watch_cursor && count < WATCH_BATCH){
+        sync_node *pair = watch_cursor;
+        watch_cursor = pair->next;
+        if(!pair->watch_pending){
+            continue;
+        }
+
+        //one watch covers every target of the source 
+        for(sync_node *curr = find_sync_pair(pair->src); curr; curr = next_sync_target(curr)){
+            curr->watch_pending = 0;
+        }
+        if(find_active_pair(pair->src)){
+            batch[count++] = pair->src;
+        }
+    }
+    if(count > 0){
+        monitor_add_watches(batch, count);
+    }
+    return watch_cursor != NULL;
+}
+
+
+//queue the next wave of initial full syncs once the previous one has drained (returns 1 while sources are still waiting)
+int schedule_initial_syncs(){
+
+    int queued_tasks = (queue_end - queue_start + MAX_QUEUE) % MAX_QUEUE;
+    int queued = 0;
+
+    while(initial_cursor && queued_tasks + queued < startup_wave){
+        sync_node *pair = initial_cursor;
+        if(pair->watch_pending){
+            break;  //the sync starts once changes are reported, so none is missed in between 
+        }
+        initial_cursor = pair->next;
+        if(!pair->initial_pending){
+            continue;
+        }
+
+        //one full sync covers every target of the source 
+        for(sync_node *curr = find_sync_pair(pair->src); curr; curr = next_sync_target(curr)){
+            curr->initial_pending = 0;
+        }
+        if(pair->active){
+            queue_sync_task(pair->src, NULL);
+            queued++;
+        }
+    }
+    return initial_cursor != NULL;
+}
+
+
 //handle a command received from console 
 void handle_command(const char *command_line, int output_fd){
 
     char command[32], source_path[256], target_path[256];
-    int parsed_args = sscanf(command_line, "%s %s %s", command, source_path, target_path);
+    int consumed = 0;
+    int parsed_args = sscanf(command_line, "%31s %255s %255s%n", command, source_path, target_path, &consumed);
 
     if(parsed_args == 3 && strcmp(command, "add") == 0){
 
@@ -214,8 +1977,11 @@ void handle_command(const char *command_line, int output_fd){
             dprintf(output_fd, "Already in queue: %s\n", source_path);
             fprintf(manager_log_file, "[ADD] Duplicate ignored: %s\n", source_path);
         } else if(result == 1){
+            if(apply_pair_options(find_sync_target(source_path, target_path), command_line + consumed) != 0){
+                dprintf(output_fd, "Unknown option ignored.\n");
+            }
             queue_sync_task(source_path, target_path);
-            add_watch(source_path); 
+            monitor_add_watch(source_path); 
             dprintf(output_fd, "Added directory: %s -> %s\n", source_path, target_path);
             log_and_print("[ADD] New pair: %s -> %s", source_path, target_path);
         } else{
@@ -224,6 +1990,81 @@ void handle_command(const char *command_line, int output_fd){
 
         dprintf(output_fd, "EXEC_REPORT_END\n");
 
+    } else if(parsed_args == 3 && strcmp(command, "throttle") == 0){
+
+        //throttle <source|global> <bytes_per_sec> <files_per_sec>
+        char files_arg[32] = "";
+        sscanf(command_line, "%*s %*s %*s %31s", files_arg);
+        long bw = parse_rate(target_path);
+        long files = parse_rate(files_arg);
+
+        dprintf(output_fd, "EXEC_REPORT_START\n");
+        if(bw < 0 || files < 0){
+            dprintf(output_fd, "Usage: throttle <source|global> <bytes_per_sec> <files_per_sec>\n");
+        } else if(strcmp(source_path, "global") == 0){
+            global_bw_limit = bw;
+            global_file_limit = files;
+            dprintf(output_fd, "Global limits set: %ld bytes/s, %ld files/s\n", bw, files);
+            log_and_print("[THROTTLE] Global limits: %ld bytes/s, %ld files/s", bw, files);
+        } else{
+            sync_node *entry = find_sync_pair(source_path);
+            if(!entry){
+                dprintf(output_fd, "Directory not monitored: %s\n", source_path);
+            } else{
+                for(sync_node *curr = entry; curr; curr = next_sync_target(curr)){
+                    curr->bw_limit = bw;
+                    curr->file_limit = files;
+                }
+                dprintf(output_fd, "Limits set for %s: %ld bytes/s, %ld files/s\n", source_path, bw, files);
+                log_and_print("[THROTTLE] %s limits: %ld bytes/s, %ld files/s", source_path, bw, files);
+            }
+        }
+        dprintf(output_fd, "EXEC_REPORT_END\n");
+
+    } else if((parsed_args == 2 || parsed_args == 3) && strcmp(command, "verify") == 0){
+
+        //verify <source> [deep]
+        int deep = (parsed_args == 3 && strcmp(target_path, "deep") == 0);
+        int result = start_verify(source_path, deep);
+
+        dprintf(output_fd, "EXEC_REPORT_START\n");
+        if(result == 0){
+            dprintf(output_fd, "Directory not monitored: %s\n", source_path);
+        } else if(result == -1){
+            dprintf(output_fd, "Verify already in progress: %s\n", source_path);
+        } else{
+            queue_verify_task(source_path);
+            save_verify_state();
+            dprintf(output_fd, "Verify started: %s%s\n", source_path, deep ? " (deep)" : "");
+            log_and_print("[VERIFY] Started: %s%s", source_path, deep ? " (deep)" : "");
+        }
+        dprintf(output_fd, "EXEC_REPORT_END\n");
+
+    } else if(parsed_args == 2 && strcmp(command, "trace") == 0){
+
+        //trace <file>: write the recorded task stages as Chrome trace-event JSON 
+        int spans = trace_dump(source_path);
+        dprintf(output_fd, "EXEC_REPORT_START\n");
+        if(spans < 0){
+            dprintf(output_fd, "Cannot write trace file: %s (%s)\n", source_path, strerror(errno));
+        } else{
+            dprintf(output_fd, "Trace written: %s (%d spans)\n", source_path, spans);
+            log_and_print("[TRACE] %d spans written to %s", spans, source_path);
+        }
+        dprintf(output_fd, "EXEC_REPORT_END\n");
+
+    } else if(parsed_args == 1 && strcmp(command, "reload") == 0){
+
+        int added, removed, kept;
+        dprintf(output_fd, "EXEC_REPORT_START\n");
+        if(reload_config(config_file_path, &added, &removed, &kept) == 0){
+            dprintf(output_fd, "Config reloaded: %d added, %d removed, %d unchanged\n", added, removed, kept);
+            log_and_print("[RELOAD] %d added, %d removed, %d unchanged", added, removed, kept);
+        } else{
+            dprintf(output_fd, "Cannot read config file: %s\n", config_file_path);
+        }
+        dprintf(output_fd, "EXEC_REPORT_END\n");
+
     } else if(parsed_args == 2 && strcmp(command, "cancel") == 0){
 
         int res = cancel_sync_pair(source_path);
@@ -238,19 +2079,9 @@ void handle_command(const char *command_line, int output_fd){
         dprintf(output_fd, "EXEC_REPORT_END\n");
 
     } else if(parsed_args == 2 && strcmp(command, "status") == 0){
-        sync_node *entry = find_sync_pair(source_path);
-        if(!entry){
-            dprintf(output_fd, "Directory not monitored: %s\nEXEC_REPORT_END\n", source_path);
-        } else{
-            const char *status = entry->active ? "Active" : "Inactive";
-            dprintf(output_fd,"EXEC_REPORT_START\n");
-            dprintf(output_fd, "Directory: %s\n", entry->src);
-            dprintf(output_fd,"Target: %s\n", entry->trg);
-            dprintf(output_fd, "Last Sync: %s\n", entry->last_sync);
-            dprintf(output_fd, "Errors: %d\n", entry->errors);
-            dprintf(output_fd, "Status: %s\n", status);
-            dprintf(output_fd, "EXEC_REPORT_END\n");
-    }
+        dprintf(output_fd, "EXEC_REPORT_START\n");
+        print_status(source_path, output_fd);
+        dprintf(output_fd, "EXEC_REPORT_END\n");
 
     } else if(parsed_args == 2 && strcmp(command, "sync") == 0){
         char target_path[PATH_MAX];
@@ -262,13 +2093,28 @@ void handle_command(const char *command_line, int output_fd){
         } else if(result == -1){
             dprintf(output_fd, "Sync already in progress %s\n", source_path);
         } else{
-            queue_sync_task(source_path, target_path);
+            queue_sync_task(source_path, NULL);
             dprintf(output_fd, "Syncing directory: %s -> %s\n", source_path, target_path);
             log_and_print("[SYNC] Manual sync started: %s -> %s", source_path, target_path);
         }
 
         dprintf(output_fd, "EXEC_REPORT_END\n");
 
+    } else if((parsed_args == 2 || parsed_args == 3) && strcmp(command, "snapshot") == 0){
+
+        //snapshot <source> [target]
+        dprintf(output_fd, "EXEC_REPORT_START\n");
+        if(!find_active_pair(source_path)){
+            dprintf(output_fd, "Directory not monitored: %s\n", source_path);
+        } else if(parsed_args == 3 && !find_sync_target(source_path, target_path)){
+            dprintf(output_fd, "Target not monitored: %s -> %s\n", source_path, target_path);
+        } else{
+            queue_snapshot_task(source_path, parsed_args == 3 ? target_path : NULL);
+            dprintf(output_fd, "Snapshot queued: %s\n", source_path);
+            log_and_print("[SNAPSHOT] Requested: %s -> %s", source_path, parsed_args == 3 ? target_path : "all targets");
+        }
+        dprintf(output_fd, "EXEC_REPORT_END\n");
+
     } else{
         dprintf(output_fd,"EXEC_REPORT_START\n");
         dprintf(output_fd,"Invalid or unsupported command.\n");
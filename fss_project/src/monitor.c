@@ -0,0 +1,107 @@
+#include "../include/monitor.h"
+#include "../include/inotify_utils.h"
+#include "../include/fanotify_utils.h"
+#include "../include/manager_utils.h"
+#include "../include/sync_list.h"
+#include "../include/trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+monitor_backend *monitor = NULL;
+
+
+//select a backend by name; fanotify falls back to inotify when it is not available (e.g. no CAP_SYS_ADMIN)
+int init_monitor(const char *backend_name){
+
+    if(backend_name && strcmp(backend_name, "fanotify") == 0){
+        if(fanotify_backend.init() == 0){
+            monitor = &fanotify_backend;
+            return 0;
+        }
+        fprintf(stderr, "fanotify not available, falling back to inotify\n");
+    } else if(backend_name && strcmp(backend_name, "inotify") != 0){
+        fprintf(stderr, "Unknown monitor backend %s, using inotify\n", backend_name);
+    }
+
+    if(inotify_backend.init() != 0){
+        return -1;
+    }
+    monitor = &inotify_backend;
+    return 0;
+}
+
+
+//switch from fanotify to inotify once fanotify turned out to be unusable and watch every active source there 
+void monitor_fall_back(const char *src){
+
+    if(monitor == &inotify_backend || inotify_backend.init() != 0){
+        return;
+    }
+    monitor = &inotify_backend;
+    log_and_print("[MONITOR] fanotify marks not permitted, falling back to inotify");
+    for(sync_node *curr = sync_list; curr; curr = curr->next){
+        if(curr->active){
+            monitor_add_watch(curr->src);  //a source with several targets is watched once 
+        }
+    }
+    monitor_add_watch(src);
+}
+
+
+//add a source directory to the selected backend 
+void monitor_add_watch(const char *src){
+    monitor->add_watch(src);
+}
+
+
+//add a batch of source directories to the selected backend 
+void monitor_add_watches(const char **srcs, int count){
+    monitor->add_watches(srcs, count);
+}
+
+
+//remove a source directory from the selected backend 
+void monitor_remove_watch(const char *src){
+    monitor->remove_watch(src);
+}
+
+
+//queue an event of a monitored source; the dispatcher groups events per pair 
+void monitor_event(const char *src, const char *filename, const char *type){
+
+    sync_node *entry = find_active_pair(src);
+    if(!entry){
+        return;
+    }
+
+    //drop the event before anything else when every active target excludes the name 
+    int wanted = 0;
+    for(sync_node *curr = find_sync_pair(src); curr && !wanted; curr = next_sync_target(curr)){
+        wanted = curr->active && !filter_excluded(&curr->filter, filename);
+    }
+    if(!wanted){
+        return;
+    }
+
+    log_and_print("[%s] Event detected: %s (%s)", monitor == &fanotify_backend ? "FANOTIFY" : "INOTIFY", filename, type);
+    unsigned long trace_id = queue_event_task(entry->src, NULL, filename, type);
+
+    //the first stage of an event runs from the read of the event buffer until it is queued 
+    char label[TRACE_LABEL_LEN];
+    snprintf(label, sizeof(label), "%.10s %.100s", type, filename);
+    trace_span(trace_id, "monitor", trace_read_started(), trace_now_us(), label);
+}
+
+
+//the kernel dropped events: resynchronize every active source 
+void monitor_overflow(){
+
+    log_and_print("[MONITOR] Event queue overflow, scheduling full syncs");
+    for(sync_node *curr = sync_list; curr; curr = curr->next){
+        if(curr->active){
+            queue_sync_task(curr->src, NULL);
+        }
+    }
+}
@@ -0,0 +1,219 @@
+#include "../include/status_shm.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+//first byte of an entry after its sequence counter
+#define ENTRY_DATA(entry) ((char *)(entry) + offsetof(status_entry, src))
+#define ENTRY_DATA_LEN (sizeof(status_entry) - offsetof(status_entry, src))
+
+
+//create the table of this manager; a table left behind by a crashed manager is replaced
+status_table *status_create(){
+
+    shm_unlink(STATUS_SHM_NAME);
+    int fd = shm_open(STATUS_SHM_NAME, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if(fd < 0){
+        perror("shm_open");
+        return NULL;
+    }
+    if(ftruncate(fd, sizeof(status_table)) == -1){
+        perror("ftruncate");
+        close(fd);
+        shm_unlink(STATUS_SHM_NAME);
+        return NULL;
+    }
+
+    status_table *table = mmap(NULL, sizeof(status_table), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(table == MAP_FAILED){
+        perror("mmap");
+        shm_unlink(STATUS_SHM_NAME);
+        return NULL;
+    }
+
+    //the new object is zero filled, so every entry starts with an even sequence
+    table->version = STATUS_VERSION;
+    table->summary.manager_pid = getpid();
+    __atomic_store_n(&table->magic, STATUS_MAGIC, __ATOMIC_RELEASE);
+    return table;
+}
+
+
+void status_destroy(status_table *table){
+    if(table){
+        munmap(table, sizeof(status_table));
+        shm_unlink(STATUS_SHM_NAME);
+    }
+}
+
+
+//begin and end a seqlock write: the counter is odd while the data is inconsistent
+static void write_begin(unsigned int *seq){
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void write_end(unsigned int *seq){
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+}
+
+
+//there is a single writer, so the entry can be compared without the lock and readers are only disturbed by real changes
+void status_write_entry(status_table *table, int slot, const status_entry *entry){
+
+    status_entry *target = &table->entries[slot];
+    if(memcmp(ENTRY_DATA(target), ENTRY_DATA(entry), ENTRY_DATA_LEN) == 0){
+        return;
+    }
+    write_begin(&target->seq);
+    memcpy(ENTRY_DATA(target), ENTRY_DATA(entry), ENTRY_DATA_LEN);
+    write_end(&target->seq);
+}
+
+
+void status_write_summary(status_table *table, const status_summary *summary){
+    write_begin(&table->seq);
+    pid_t manager_pid = table->summary.manager_pid;
+    table->summary = *summary;
+    table->summary.manager_pid = manager_pid;
+    write_end(&table->seq);
+}
+
+
+//map the table read-only; a table whose manager is gone or that was never published counts as missing
+const status_table *status_attach(){
+
+    int fd = shm_open(STATUS_SHM_NAME, O_RDONLY, 0);
+    if(fd < 0){
+        return NULL;
+    }
+    struct stat st;
+    if(fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(status_table)){
+        close(fd);
+        return NULL;
+    }
+    const status_table *table = mmap(NULL, sizeof(status_table), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(table == MAP_FAILED){
+        return NULL;
+    }
+
+    if(__atomic_load_n(&table->magic, __ATOMIC_ACQUIRE) != STATUS_MAGIC || table->version != STATUS_VERSION || kill(table->summary.manager_pid, 0) == -1){
+        munmap((void *)table, sizeof(status_table));
+        return NULL;
+    }
+
+    //the manager publishes only once a console is connected and the config is loaded 
+    status_summary summary;
+    status_read_summary(table, &summary);
+    if(summary.updated == 0){
+        munmap((void *)table, sizeof(status_table));
+        return NULL;
+    }
+    return table;
+}
+
+
+void status_detach(const status_table *table){
+    if(table){
+        munmap((void *)table, sizeof(status_table));
+    }
+}
+
+
+//copy data guarded by a seqlock, retrying while the writer is active or finished a write meanwhile
+static void read_consistent(const unsigned int *seq, void *dst, const void *src, size_t len){
+    unsigned int before, after;
+    do{
+        while((before = __atomic_load_n(seq, __ATOMIC_ACQUIRE)) & 1){
+            sched_yield();  //a write is in progress 
+        }
+        memcpy(dst, src, len);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(seq, __ATOMIC_RELAXED);
+    } while(before != after);
+}
+
+
+void status_read_entry(const status_table *table, int slot, status_entry *entry){
+    const status_entry *source = &table->entries[slot];
+    read_consistent(&source->seq, ENTRY_DATA(entry), ENTRY_DATA(source), ENTRY_DATA_LEN);
+    entry->seq = 0;
+}
+
+
+void status_read_summary(const status_table *table, status_summary *summary){
+    read_consistent(&table->seq, summary, &table->summary, sizeof(*summary));
+}
+
+
+//append formatted text to a buffer, stopping quietly when it is full 
+static void append_text(char *buffer, size_t size, size_t *len, const char *format, ...){
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buffer + *len, size - *len, format, args);
+    va_end(args);
+    if(n > 0){
+        *len = (*len + n < size) ? *len + n : size - 1;
+    }
+}
+
+
+//format the block printed for one target by the status command 
+int status_format_entry(const status_entry *entry, char *buffer, size_t size){
+
+    size_t len = 0;
+    buffer[0] = '\0';
+    append_text(buffer, size, &len, "Target: %s\nLast Sync: %s\nResult: %s\nErrors: %d\nStatus: %s\nMode: %s\nLimits: %ld bytes/s, %ld files/s\n", entry->trg, entry->last_sync, entry->result, entry->errors, entry->active ? "Active" : "Inactive", entry->mirror ? "Mirror" : "Copy", entry->bw_limit, entry->file_limit);
+    if(entry->snapshot_interval > 0 || entry->snapshot_result[0] != '\0'){
+        append_text(buffer, size, &len, "Last Snapshot: %s %s (every %ld s)\n", entry->last_snapshot, entry->snapshot_result, entry->snapshot_interval);
+    }
+    if(entry->verify_running){
+        append_text(buffer, size, &len, "Verify: running%s, %d/%d files, %d mismatches\n", entry->verify_deep ? " (deep)" : "", entry->verify_done, entry->verify_total, entry->verify_mismatches);
+    } else if(entry->scrub_interval > 0 || strcmp(entry->last_verify, "Never") != 0){
+        append_text(buffer, size, &len, "Verify: last %s, %d files, %d mismatches (scrub every %ld s)\n", entry->last_verify, entry->verify_done, entry->verify_mismatches, entry->scrub_interval);
+    }
+    if(entry->filters[0] != '\0'){
+        append_text(buffer, size, &len, "Filters: %s\n", entry->filters);
+    }
+    if(entry->compress){
+        append_text(buffer, size, &len, "Compression: %lld bytes stored as %lld", entry->compress_raw, entry->compress_stored);
+        if(entry->compress_raw > 0){
+            append_text(buffer, size, &len, " (ratio %.2f, %.0f%% fewer bytes written)", (double)entry->compress_raw / (entry->compress_stored > 0 ? entry->compress_stored : 1), 100.0 * (entry->compress_raw - entry->compress_stored) / entry->compress_raw);
+        }
+        append_text(buffer, size, &len, "\n");
+    }
+    if(entry->dedup[0] != '\0'){
+        append_text(buffer, size, &len, "Dedup: %s, %ld files, %lld bytes saved\n", entry->dedup, entry->dedup_files, entry->dedup_bytes);
+    }
+    if(entry->failures > 0){
+        append_text(buffer, size, &len, "Health: %s, %d failed runs in a row\n", entry->degraded ? "Degraded" : "Retrying", entry->failures);
+    }
+    if(entry->queued > 0 || entry->running){
+        append_text(buffer, size, &len, "Queue: %d tasks waiting%s\n", entry->queued, entry->running ? ", worker running" : "");
+    }
+    return len;
+}
+
+
+//find the next entry of a source, starting at slot from
+int status_find(const status_table *table, const char *src, int from, status_entry *entry){
+    status_summary summary;
+    status_read_summary(table, &summary);
+    for(int slot = from; slot < summary.count; slot++){
+        status_read_entry(table, slot, entry);
+        if(strcmp(entry->src, src) == 0){
+            return slot;
+        }
+    }
+    return -1;
+}
@@ -7,18 +7,33 @@
 
 
 sync_node *sync_list = NULL;
+static sync_node *sync_hash[SYNC_HASH_SIZE];  //nodes chained by source path, so lookups do not scan the whole list
+
+
+//hash a source path into the lookup table (djb2)
+static unsigned long hash_path(const char *path){
+    unsigned long hash = 5381;
+    while(*path){
+        hash = hash * 33 + (unsigned char)*path++;
+    }
+    return hash % SYNC_HASH_SIZE;
+}
+
 
 //add a new (source, target) synchronization pair 
 int add_sync_pair(const char *src, const char *trg){
 
-    sync_node *curr = sync_list;
-
-    //check if the source already exists 
-    while(curr){
-        if(strcmp(curr->src, src) == 0){
+    //check if the pair already exists; a source may fan out to several targets 
+    int targets = 0;
+    sync_node *first = find_sync_pair(src);
+    for(sync_node *curr = first; curr; curr = next_sync_target(curr)){
+        if(strcmp(curr->trg, trg) == 0){
             return 0;  //already exists
         }
-        curr = curr->next;
+        targets++;
+    }
+    if(targets >= MAX_TARGETS){
+        return -1;
     }
 
     sync_node *new_pair = malloc(sizeof(sync_node));
@@ -30,54 +45,433 @@ int add_sync_pair(const char *src, const char *trg){
     strncpy(new_pair->trg, trg, PATH_MAX);
     new_pair->active = 1;
     new_pair->errors = 0;
+    new_pair->failures = 0;
+    new_pair->degraded = 0;
     new_pair->syncing = 0;
+    new_pair->initial_pending = 0;
+    new_pair->watch_pending = 0;
+    new_pair->seen = 0;
+    new_pair->next_snapshot = 0;
+    strcpy(new_pair->last_snapshot, "Never");
+    new_pair->snapshot_result[0] = '\0';
+    filter_init(&new_pair->filter);
+    new_pair->dedup[0] = '\0';
+    new_pair->dedup_store[0] = '\0';
+    new_pair->dedup_files = 0;
+    new_pair->dedup_bytes = 0;
+    new_pair->compress = 0;
+    new_pair->compress_raw = 0;
+    new_pair->compress_stored = 0;
+    new_pair->verify_running = 0;
+    new_pair->verify_deep = 0;
+    new_pair->verify_done = 0;
+    new_pair->verify_total = 0;
+    new_pair->verify_mismatches = 0;
+    new_pair->verify_cursor[0] = '\0';
+    strcpy(new_pair->last_verify, "Never");
+    new_pair->next_scrub = 0;
+    new_pair->status_slot = -1;
+    new_pair->queued = 0;
+    new_pair->running = 0;
+    reset_pair_options(new_pair);
 
     strcpy(new_pair->result, "PENDING");
 
     //set current timestamp at last sync 
     time_t now = time(NULL);
     strftime(new_pair->last_sync, sizeof(new_pair->last_sync), "%F %T", localtime(&now));
+    //a target added during a verify joins it, so the state stays the same on every target 
+    if(first && first->verify_running){
+        new_pair->verify_running = 1;
+        new_pair->verify_deep = first->verify_deep;
+        new_pair->verify_done = first->verify_done;
+        new_pair->verify_total = first->verify_total;
+        strcpy(new_pair->verify_cursor, first->verify_cursor);
+    }
+
     new_pair->next = sync_list;
     sync_list = new_pair;
 
+    //new nodes go to the end of their bucket: the first target of a source keeps the verify and queue state 
+    //that is read through find_sync_pair 
+    new_pair->hash_next = NULL;
+    sync_node **link = &sync_hash[hash_path(src)];
+    while(*link){
+        link = &(*link)->hash_next;
+    }
+    *link = new_pair;
+
     return 1;
 }
 
 
 //find a sync pair by its source directory 
 sync_node *find_sync_pair(const char *src){
-    sync_node *curr = sync_list;
+    sync_node *curr = sync_hash[hash_path(src)];
     while(curr){
         if(strcmp(curr->src, src) == 0){
             return curr;
         }
-        curr = curr->next;
+        curr = curr->hash_next;
     }
     return NULL;
 }
 
 
-//cancel monitoring for a given source directory 
-int cancel_sync_pair(const char *src){
-    sync_node *entry = find_sync_pair(src);
-    if(entry && entry->active){
-        entry->active = 0;
+//continue from a pair to the next target of the same source 
+sync_node *next_sync_target(sync_node *pair){
+    sync_node *curr = pair->hash_next;
+    while(curr){
+        if(strcmp(curr->src, pair->src) == 0){
+            return curr;
+        }
+        curr = curr->hash_next;
+    }
+    return NULL;
+}
+
+
+//find the pair of a specific source and target directory 
+sync_node *find_sync_target(const char *src, const char *trg){
+    for(sync_node *curr = find_sync_pair(src); curr; curr = next_sync_target(curr)){
+        if(strcmp(curr->trg, trg) == 0){
+            return curr;
+        }
+    }
+    return NULL;
+}
+
+
+//find any active target of a source directory 
+sync_node *find_active_pair(const char *src){
+    for(sync_node *curr = find_sync_pair(src); curr; curr = next_sync_target(curr)){
+        if(curr->active){
+            return curr;
+        }
+    }
+    return NULL;
+}
+
+
+//join the active targets of a source (or only only_trg if given) for the worker command line
+//mirror_mask receives the comma separated indexes of the mirror targets 
+int collect_targets(const char *src, const char *only_trg, char *list, size_t list_size, char *mirror_mask, size_t mask_size){
+
+    int count = 0;
+    list[0] = '\0';
+    mirror_mask[0] = '\0';
+
+    for(sync_node *curr = find_sync_pair(src); curr && count < MAX_TARGETS; curr = next_sync_target(curr)){
+        if(!curr->active){
+            continue;
+        }
+        if(only_trg && only_trg[0] != '\0' && strcmp(curr->trg, only_trg) != 0){
+            continue;
+        }
+        if(strlen(list) + strlen(curr->trg) + 2 > list_size){
+            break;
+        }
+        if(count > 0){
+            strcat(list, ":");
+        }
+        strcat(list, curr->trg);
+
+        if(curr->mirror){
+            char index[16];
+            snprintf(index, sizeof(index), "%s%d", mirror_mask[0] ? "," : "", count);
+            strncat(mirror_mask, index, mask_size - strlen(mirror_mask) - 1);
+        }
+        count++;
+    }
+    return count;
+}
+
+
+//check whether a target of a source (any target if trg is empty) is degraded 
+int source_degraded(const char *src, const char *trg){
+    for(sync_node *curr = find_sync_pair(src); curr; curr = next_sync_target(curr)){
+        if(curr->degraded && (trg[0] == '\0' || strcmp(curr->trg, trg) == 0)){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+//count a run in the consecutive failures of a target (returns 1 when it became degraded, -1 when it recovered)
+static int record_outcome(sync_node *entry, const char *status){
+
+    if(strcmp(status, "SUCCESS") == 0){
+        entry->failures = 0;
+        if(entry->degraded){
+            entry->degraded = 0;
+            return -1;
+        }
+        return 0;
+    }
+
+    entry->errors++;
+    entry->failures++;
+    if(!entry->degraded && entry->failures >= DEGRADED_AFTER){
+        entry->degraded = 1;
         return 1;
     }
     return 0;
 }
 
 
-//print the status information of a monitored directory 
-void print_status(const char *src, int fd){
-    sync_node *entry = find_sync_pair(src);
+//record the outcome of a worker run for one target 
+int update_target_status(const char *src, const char *trg, const char *status, int full_sync){
+
+    sync_node *entry = find_sync_target(src, trg);
+    if(!entry){
+        return 0;
+    }
+
+    strncpy(entry->result, status, sizeof(entry->result) - 1);
+    entry->result[sizeof(entry->result) - 1] = '\0';
+    int change = record_outcome(entry, status);
+
+    time_t now = time(NULL);
+    strftime(entry->last_sync, sizeof(entry->last_sync), "%F %T", localtime(&now));
+
+    //a finished full sync ends a manual sync for every target of the source 
+    if(full_sync){
+        for(sync_node *curr = find_sync_pair(src); curr; curr = next_sync_target(curr)){
+            curr->syncing = 0;
+        }
+    }
+    return change;
+}
+
+
+//cancel monitoring for a given source directory and all of its targets 
+int cancel_sync_pair(const char *src){
+    int cancelled = 0;
+    for(sync_node *curr = find_sync_pair(src); curr; curr = next_sync_target(curr)){
+        if(curr->active){
+            curr->active = 0;
+            cancelled++;
+        }
+    }
+    return cancelled;
+}
+
+
+//parse a rate such as "512", "64K" or "10M" (returns -1 on error)
+long parse_rate(const char *text){
+    char *end;
+    long value = strtol(text, &end, 10);
+    if(end == text || value < 0){
+        return -1;
+    }
+
+    switch(*end){
+        case '\0': return value;
+        case 'K': case 'k': return value * 1024;
+        case 'M': case 'm': return value * 1024 * 1024;
+        case 'G': case 'g': return value * 1024 * 1024 * 1024;
+        default: return -1;
+    }
+}
+
+
+//start a verify of a source: every target of the source shares the progress, mismatches are counted per target 
+int start_verify(const char *src, int deep){
+
+    if(!find_active_pair(src)){
+        return 0;
+    }
+    sync_node *first = find_sync_pair(src);
+    if(first->verify_running){
+        return -1;
+    }
+
+    for(sync_node *curr = first; curr; curr = next_sync_target(curr)){
+        curr->verify_running = 1;
+        curr->verify_deep = deep;
+        curr->verify_done = 0;
+        curr->verify_total = 0;
+        curr->verify_mismatches = 0;
+        curr->verify_cursor[0] = '\0';
+    }
+    return 1;
+}
+
+
+//clear the running verify of every target of a source, keeping the counts of the slices that ran 
+void stop_verify(const char *src){
+    for(sync_node *curr = find_sync_pair(src); curr; curr = next_sync_target(curr)){
+        curr->verify_running = 0;
+    }
+}
+
+
+//parse a duration in seconds with an optional m/h/d suffix, used for snapshot intervals 
+long parse_interval(const char *text){
+    char *end;
+    long value = strtol(text, &end, 10);
+    if(end == text || value < 0){
+        return -1;
+    }
+
+    switch(*end){
+        case '\0': case 's': return value;
+        case 'm': return value * 60;
+        case 'h': return value * 3600;
+        case 'd': return value * 86400;
+        default: return -1;
+    }
+}
+
+
+//record the result of a snapshot of one target (the sync status is left unchanged)
+int update_snapshot_status(const char *src, const char *trg, const char *status){
+
+    sync_node *entry = find_sync_target(src, trg);
     if(!entry){
+        return 0;
+    }
+
+    strncpy(entry->snapshot_result, status, sizeof(entry->snapshot_result) - 1);
+    entry->snapshot_result[sizeof(entry->snapshot_result) - 1] = '\0';
+    int change = record_outcome(entry, status);
+
+    time_t now = time(NULL);
+    strftime(entry->last_snapshot, sizeof(entry->last_snapshot), "%F %T", localtime(&now));
+    return change;
+}
+
+
+//restore the options that a config line or add command may change 
+void reset_pair_options(sync_node *pair){
+    pair->mirror = 0;
+    pair->bw_limit = 0;
+    pair->file_limit = 0;
+    pair->ioprio[0] = '\0';
+    pair->snapshot_interval = 0;
+    pair->scrub_interval = 0;
+    pair->dedup[0] = '\0';
+    pair->dedup_store[0] = '\0';
+    pair->compress = 0;
+    filter_free(&pair->filter);
+}
+
+
+//apply the optional settings that follow the source and target paths (returns 0 on success, -1 on unknown option)
+int apply_pair_options(sync_node *pair, const char *options){
+
+    if(!pair || !options){
+        return 0;
+    }
+
+    char buffer[512];
+    strncpy(buffer, options, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+
+    int result = 0;
+    char *saveptr;
+    char *token = strtok_r(buffer, " \t\n", &saveptr);
+    while(token){
+        if(strcmp(token, "mirror") == 0){
+            pair->mirror = 1;
+        } else if(strncmp(token, "bwlimit=", 8) == 0 && parse_rate(token + 8) >= 0){
+            pair->bw_limit = parse_rate(token + 8);
+        } else if(strncmp(token, "filelimit=", 10) == 0 && parse_rate(token + 10) >= 0){
+            pair->file_limit = parse_rate(token + 10);
+        } else if(strncmp(token, "snapshot_interval=", 18) == 0 && parse_interval(token + 18) >= 0){
+            pair->snapshot_interval = parse_interval(token + 18);
+            if(pair->next_snapshot == 0){
+                pair->next_snapshot = time(NULL) + pair->snapshot_interval;  //kept across reloads 
+            }
+        } else if(strncmp(token, "scrub_interval=", 15) == 0 && parse_interval(token + 15) >= 0){
+            pair->scrub_interval = parse_interval(token + 15);
+            if(pair->next_scrub == 0){
+                pair->next_scrub = time(NULL) + pair->scrub_interval;  //kept across reloads 
+            }
+        } else if(strncmp(token, "exclude=", 8) == 0 && filter_add(&pair->filter, token + 8, 1) == 0){
+            //excluded names are never queued or copied 
+        } else if(strncmp(token, "include=", 8) == 0 && filter_add(&pair->filter, token + 8, 0) == 0){
+            //with include rules only matching names are synchronized 
+        } else if(strcmp(token, "dedup") == 0 || strcmp(token, "dedup=clone") == 0){
+            strcpy(pair->dedup, "clone");
+        } else if(strcmp(token, "dedup=link") == 0){
+            strcpy(pair->dedup, "link");
+        } else if(strncmp(token, "dedup_store=", 12) == 0 && token[12] == '/'){
+            strcpy(pair->dedup_store, token + 12);  //shorter than the options buffer 
+        } else if(strcmp(token, "compress") == 0){
+            pair->compress = 1;
+        } else if(strcmp(token, "ioprio=idle") == 0 || strcmp(token, "ioprio=be") == 0){
+            strcpy(pair->ioprio, token + 7);
+        } else{
+            result = -1;  //unknown option
+        }
+        token = strtok_r(NULL, " \t\n", &saveptr);
+    }
+    return result;
+}
+
+
+//print the status information of a monitored directory, one block per target 
+void print_status(const char *src, int fd){
+    if(!find_sync_pair(src)){
         dprintf(fd, "Directory not monitored: %s\n", src);
         return;
     }
 
-    const char *status = entry->active ? "Active" : "Inactive";
-    dprintf(fd, "Directory: %s\nTarget: %s\nLast Sync: %s\nErrors: %d\nStatus: %s\n", entry->src, entry->trg, entry->last_sync, entry->errors, status);
+    //the same block is published in the shared status table, so both ways of asking print it alike 
+    dprintf(fd, "Directory: %s\n", src);
+    for(sync_node *pair = find_sync_pair(src); pair; pair = next_sync_target(pair)){
+        status_entry entry;
+        char block[4096];
+        fill_status_entry(pair, &entry);
+        status_format_entry(&entry, block, sizeof(block));
+        dprintf(fd, "%s", block);
+    }
+}
+
+
+//copy the state of a pair into a status table entry; queue counts are taken from the first target of the source 
+void fill_status_entry(const sync_node *pair, status_entry *entry){
+
+    memset(entry, 0, sizeof(*entry));
+    strncpy(entry->src, pair->src, sizeof(entry->src) - 1);
+    strncpy(entry->trg, pair->trg, sizeof(entry->trg) - 1);
+    strncpy(entry->last_sync, pair->last_sync, sizeof(entry->last_sync) - 1);
+    strncpy(entry->result, pair->result, sizeof(entry->result) - 1);
+    entry->errors = pair->errors;
+    entry->failures = pair->failures;
+    entry->active = pair->active;
+    entry->syncing = pair->syncing;
+    entry->degraded = pair->degraded;
+    entry->mirror = pair->mirror;
+    entry->bw_limit = pair->bw_limit;
+    entry->file_limit = pair->file_limit;
+    entry->snapshot_interval = pair->snapshot_interval;
+    strncpy(entry->last_snapshot, pair->last_snapshot, sizeof(entry->last_snapshot) - 1);
+    strncpy(entry->snapshot_result, pair->snapshot_result, sizeof(entry->snapshot_result) - 1);
+    entry->verify_running = pair->verify_running;
+    entry->verify_deep = pair->verify_deep;
+    entry->verify_done = pair->verify_done;
+    entry->verify_total = pair->verify_total;
+    entry->verify_mismatches = pair->verify_mismatches;
+    strncpy(entry->last_verify, pair->last_verify, sizeof(entry->last_verify) - 1);
+    entry->scrub_interval = pair->scrub_interval;
+    if(pair->filter.count > 0){
+        strncpy(entry->filters, pair->filter.spec, sizeof(entry->filters) - 1);
+    }
+    strcpy(entry->dedup, pair->dedup);
+    entry->dedup_files = pair->dedup_files;
+    entry->dedup_bytes = pair->dedup_bytes;
+    entry->compress = pair->compress;
+    entry->compress_raw = pair->compress_raw;
+    entry->compress_stored = pair->compress_stored;
+
+    sync_node *first = find_sync_pair(pair->src);
+    if(first){
+        entry->queued = first->queued;
+        entry->running = first->running;
+    }
 }
 
 
@@ -87,16 +481,18 @@ void free_sync_list(){
     while(curr){
         sync_node *tmp = curr;
         curr = curr->next;
+        filter_free(&tmp->filter);
         free(tmp);
     }
     sync_list = NULL;
+    memset(sync_hash, 0, sizeof(sync_hash));
 }
 
 
 //mark a sync pair for manual synchronization 
 int start_manual_sync(const char *src, char *trg_out){
-    sync_node *entry = find_sync_pair(src);
-    if(!entry || !entry->active){
+    sync_node *entry = find_active_pair(src);
+    if(!entry){
         return 0; 
     }
 
@@ -0,0 +1,111 @@
+#include "../include/trace.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+
+//one timed stage of a task: monitor read, queue wait, spawn, copy or report handling 
+typedef struct{
+    unsigned long id;
+    char stage[16];
+    long long start_us;
+    long long dur_us;
+    char label[TRACE_LABEL_LEN];  //only set on the first span of a task 
+}trace_span_entry;
+
+static trace_span_entry spans[TRACE_MAX_SPANS];
+static unsigned long span_total = 0;  //spans recorded so far, the ring holds the newest ones 
+static unsigned long next_id = 1;
+static long long read_started_us = 0;
+
+
+long long trace_now_us(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+unsigned long trace_new_id(){
+    return next_id++;
+}
+
+
+void trace_monitor_read(){
+    read_started_us = trace_now_us();
+}
+
+
+long long trace_read_started(){
+    return read_started_us;
+}
+
+
+void trace_span(unsigned long id, const char *stage, long long start_us, long long end_us, const char *label){
+
+    if(id == 0 || start_us <= 0){
+        return;
+    }
+    trace_span_entry *span = &spans[span_total % TRACE_MAX_SPANS];
+    span_total++;
+
+    span->id = id;
+    strncpy(span->stage, stage, sizeof(span->stage) - 1);
+    span->stage[sizeof(span->stage) - 1] = '\0';
+    span->start_us = start_us;
+    span->dur_us = end_us > start_us ? end_us - start_us : 0;
+    span->label[0] = '\0';
+    if(label){
+        strncpy(span->label, label, sizeof(span->label) - 1);
+        span->label[sizeof(span->label) - 1] = '\0';
+    }
+}
+
+
+//write a string as a JSON string literal 
+static void write_json_string(FILE *out, const char *text){
+    fputc('"', out);
+    for(const unsigned char *c = (const unsigned char *)text; *c; c++){
+        if(*c == '"' || *c == '\\'){
+            fprintf(out, "\\%c", *c);
+        } else if(*c < 0x20){
+            fprintf(out, "\\u%04x", *c);
+        } else{
+            fputc(*c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+
+//dump the ring in Chrome trace-event format: one row (tid) per task, one complete event per stage 
+int trace_dump(const char *path){
+
+    FILE *out = fopen(path, "w");
+    if(!out){
+        return -1;
+    }
+
+    unsigned long first = span_total > TRACE_MAX_SPANS ? span_total - TRACE_MAX_SPANS : 0;
+    int written = 0;
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for(unsigned long i = first; i < span_total; i++){
+        trace_span_entry *span = &spans[i % TRACE_MAX_SPANS];
+        if(span->label[0] != '\0'){
+            //name the row after the task 
+            fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%lu,\"args\":{\"name\":", written ? ",\n" : "", span->id);
+            write_json_string(out, span->label);
+            fprintf(out, "}}");
+            written++;
+        }
+        fprintf(out, "%s{\"name\":\"%s\",\"cat\":\"fss\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,\"ts\":%lld,\"dur\":%lld,\"args\":{\"trace_id\":%lu}}",
+                written ? ",\n" : "", span->stage, span->id, span->start_us, span->dur_us, span->id);
+        written++;
+    }
+    fprintf(out, "\n]}\n");
+
+    if(fclose(out) != 0){
+        return -1;
+    }
+    return (int)(span_total - first);
+}
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,160 +9,2301 @@
 #include <dirent.h>
 #include <time.h>
 #include <limits.h>
+#include <sys/syscall.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include "../include/fss_manager.h"
+#include "../include/filter.h"
+#include "../include/fsz_codec.h"
 
-#define BUF_SIZE 1024
+#define BUF_SIZE 65536
 #define ERR_BUF_SIZE 4096
+#define DIRENT_BUF_SIZE 32768
+#define DEFAULT_PARALLEL_THRESHOLD (1024L * 1024 * 1024)  //files from this size are copied by several threads 
+#define DEFAULT_COPY_THREADS 4
+#define MAX_COPY_THREADS 64
+#define CHUNK_ALIGN (1024 * 1024)  //range boundaries are aligned to 1 MiB
+#define DEFAULT_BULK_THRESHOLD (64L * 1024 * 1024)  //files from this size bypass the page cache as far as possible 
+#define BULK_WINDOW (8 * 1024 * 1024)  //write-behind window of a bulk copy 
+#define DEFAULT_VERIFY_SLICE 1000  //files checked by one verify run before the manager resumes it 
+#define MAX_FAILED_LINES 64  //failed entries of a batch listed in its report 
+#define MISMATCH_BYTES 3072  //MISMATCH lines of a verify slice, more are counted in UNLISTED lines 
+#define DEDUP_MIN_SIZE 4096  //smaller files are always copied, sharing them saves less than the lookup costs 
+#define DEDUP_STORE ".fss_dedup"  //content store created once per target filesystem 
+#define DEDUP_OFF 0
+#define DEDUP_CLONE 1  //share the extents of the stored copy with FICLONE (btrfs, xfs, ...)
+#define DEDUP_LINK 2  //hard link the target to the stored copy 
+#define TEMP_NAME_LEN (NAME_MAX + 16)  //".<name>.fss_part"
 
+//io priority values for ioprio_set (not exported by glibc)
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_PRIO_VALUE(class, data) (((class) << IOPRIO_CLASS_SHIFT) | (data))
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_CLASS_BE 2
+#define IOPRIO_CLASS_IDLE 3
+#define IOPRIO_BE_LOWEST 7
 
-//copy a file from source to target (returns 1 on success, 0 on failure)
-int copy_file(const char *src, const char *trg, char *err_buf, int *errors){
 
-    int fd_src = open(src, O_RDONLY);
+//token bucket used to limit bytes/s and files/s (rate 0 means unlimited)
+typedef struct{
+    double rate;
+    double burst;
+    double tokens;
+    struct timespec last;
+    pthread_mutex_t lock;  //shared by the parallel copy threads
+}token_bucket;
+
+token_bucket byte_bucket;
+token_bucket file_bucket;
+
+//limit updates of a background sync: the manager writes "<bytes/s> <files/s>" lines and sends SIGUSR1 
+static int limit_fd = -1;
+static volatile sig_atomic_t limits_changed = 0;
+static pthread_mutex_t limit_lock = PTHREAD_MUTEX_INITIALIZER;
+
+long parallel_threshold = DEFAULT_PARALLEL_THRESHOLD;
+long bulk_threshold = DEFAULT_BULK_THRESHOLD;  //0 disables the bulk mode 
+int copy_threads = DEFAULT_COPY_THREADS;
+
+
+//one target directory of a (possibly fan-out) run and its results 
+typedef struct{
+    const char *dir;
+    int fd;  //the directory opened once per run, files are reached relative to it 
+    int fd_errno;  //why it could not be opened (fd < 0)
+    int mirror;
+    int copied;
+    int failed;
+    int pruned;
+    int linked;  //files hard-linked to the previous snapshot 
+    int dedup;  //DEDUP_OFF, DEDUP_CLONE or DEDUP_LINK (FSS_DEDUP_<index>)
+    const char *store_dir;  //dedup store set for the pair (FSS_DEDUP_STORE_<index>), NULL to search for one 
+    int store_state;  //0 not looked up yet, 1 usable, -1 unavailable 
+    int store_fd;  //dedup store of the target filesystem 
+    dev_t store_dev;  //identity of the store, targets of one run may share it 
+    ino_t store_ino;
+    int deduped;  //files taken from the store instead of being written 
+    long long dedup_bytes;
+    int compress;  //store files compressed (FSS_COMPRESS_<index>)
+    long long raw_bytes;  //source bytes compressed by this run 
+    long long stored_bytes;  //bytes written for them 
+}target_dir;
+
+target_dir targets[MAX_TARGETS];
+int target_count = 0;
+filter_set target_filters[MAX_TARGETS];  //include/exclude rules of each target (FSS_FILTER_<index>)
+
+const char *src_path = "";  //source directory of the run, for messages 
+int src_fd = -1;  //the source directory opened once per run 
+int src_errno = 0;  //why it could not be opened 
+
+long long start_us = 0;  //monotonic start time, reported with the trace id 
+long long bytes_read = 0;  //source bytes read by this run (updated by the copy threads)
+long files_done = 0;  //source files copied or deleted by this run 
+
+
+//one range of a parallel copy 
+typedef struct{
+    int fd_src;
+    const int *fds;
+    int count;
+    int errs[MAX_TARGETS];  //errno of each target that failed in this range, 0 if fine
+    off_t start;
+    off_t end;
+    int bulk;
+    int result;
+    int saved_errno;
+}copy_chunk;
+
+
+//raw directory entry layout returned by the getdents64 system call
+struct linux_dirent64{
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+
+//monotonic clock in microseconds, comparable with the manager's trace timestamps 
+long long monotonic_us(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+//initialize a token bucket that allows one second worth of burst 
+void bucket_init(token_bucket *bucket, double rate, double min_burst){
+    bucket->rate = rate;
+    bucket->burst = rate > min_burst ? rate : min_burst;
+    bucket->tokens = bucket->burst;
+    clock_gettime(CLOCK_MONOTONIC, &bucket->last);
+    pthread_mutex_init(&bucket->lock, NULL);
+}
+
+
+//change the rate of a bucket while copies are running 
+static void bucket_set_rate(token_bucket *bucket, double rate, double min_burst){
+    pthread_mutex_lock(&bucket->lock);
+    bucket->rate = rate;
+    bucket->burst = rate > min_burst ? rate : min_burst;
+    if(bucket->tokens > bucket->burst){
+        bucket->tokens = bucket->burst;
+    }
+    pthread_mutex_unlock(&bucket->lock);
+}
+
+
+static void limit_signal_handler(int signal_number){
+    (void)signal_number;
+    limits_changed = 1;
+}
+
+
+//apply the last limits written by the manager since the previous SIGUSR1 
+static void refresh_limits(){
+
+    if(!limits_changed){
+        return;
+    }
+    pthread_mutex_lock(&limit_lock);
+    if(limits_changed){
+        limits_changed = 0;
+
+        //only the last complete line counts; a partial one is kept for the next read 
+        char buffer[512];
+        size_t used = 0;
+        double bw = -1, files = -1;
+        ssize_t n;
+        while((n = read(limit_fd, buffer + used, sizeof(buffer) - 1 - used)) > 0){
+            used += n;
+            buffer[used] = '\0';
+            char *start = buffer, *end;
+            while((end = strchr(start, '\n')) != NULL){
+                sscanf(start, "%lf %lf", &bw, &files);
+                start = end + 1;
+            }
+            used = strlen(start);
+            memmove(buffer, start, used);
+        }
+        if(bw >= 0 && files >= 0){
+            bucket_set_rate(&byte_bucket, bw, BUF_SIZE);
+            bucket_set_rate(&file_bucket, files, 1);
+        }
+    }
+    pthread_mutex_unlock(&limit_lock);
+}
+
+
+//take tokens from the bucket, sleeping while the bucket is in debt 
+void bucket_consume(token_bucket *bucket, double amount){
+
+    refresh_limits();
+    if(bucket->rate <= 0){
+        return;
+    }
+
+    pthread_mutex_lock(&bucket->lock);
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double elapsed = (now.tv_sec - bucket->last.tv_sec) + (now.tv_nsec - bucket->last.tv_nsec) / 1e9;
+    bucket->last = now;
+
+    bucket->tokens += elapsed * bucket->rate;
+    if(bucket->tokens > bucket->burst){
+        bucket->tokens = bucket->burst;
+    }
+
+    bucket->tokens -= amount;
+    double debt = -bucket->tokens;
+    pthread_mutex_unlock(&bucket->lock);
+
+    if(debt > 0){
+        double wait = debt / bucket->rate;
+        struct timespec ts;
+        ts.tv_sec = (time_t)wait;
+        ts.tv_nsec = (long)((wait - ts.tv_sec) * 1e9);
+        while(nanosleep(&ts, &ts) == -1 && errno == EINTR);
+    }
+}
+
+
+//read the limits passed by the manager through the environment (only set for background syncs)
+void init_throttling(){
+
+    const char *bw = getenv("FSS_BW_LIMIT");
+    const char *files = getenv("FSS_FILE_LIMIT");
+    const char *prio = getenv("FSS_IOPRIO");
+
+    bucket_init(&byte_bucket, bw ? atof(bw) : 0, BUF_SIZE);
+    bucket_init(&file_bucket, files ? atof(files) : 0, 1);
+
+    //the manager blocked SIGUSR1 before exec, so an update sent before the handler exists is delivered now 
+    const char *updates = getenv("FSS_LIMIT_FD");
+    if(updates){
+        limit_fd = atoi(updates);
+        fcntl(limit_fd, F_SETFD, FD_CLOEXEC);
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = limit_signal_handler;
+        action.sa_flags = SA_RESTART;
+        sigaction(SIGUSR1, &action, NULL);
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGUSR1);
+        sigprocmask(SIG_UNBLOCK, &mask, NULL);
+    }
+
+    const char *threshold = getenv("FSS_PARALLEL_THRESHOLD");
+    const char *threads = getenv("FSS_COPY_THREADS");
+    const char *bulk = getenv("FSS_BULK_THRESHOLD");
+    if(bulk && atol(bulk) >= 0){
+        bulk_threshold = atol(bulk);
+    }
+    if(threshold && atol(threshold) > 0){
+        parallel_threshold = atol(threshold);
+    }
+    if(threads && atoi(threads) > 0){
+        copy_threads = atoi(threads) < MAX_COPY_THREADS ? atoi(threads) : MAX_COPY_THREADS;
+    }
+
+    if(prio){
+        int value = -1;
+        if(strcmp(prio, "idle") == 0){
+            value = IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0);
+        } else if(strcmp(prio, "be") == 0){
+            value = IOPRIO_PRIO_VALUE(IOPRIO_CLASS_BE, IOPRIO_BE_LOWEST);
+        }
+        if(value >= 0 && syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, value) == -1){
+            fprintf(stderr, "ioprio_set failed (%s)\n", strerror(errno));
+        }
+    }
+}
+
+
+//append a message to the error buffer without overflowing it
+void append_error(char *err_buf, const char *msg){
+    strncat(err_buf, msg, ERR_BUF_SIZE - strlen(err_buf) - 1);
+    err_buf[ERR_BUF_SIZE - 1] = '\0';
+}
+
+
+//write a whole buffer at the given offset (returns 0 on success, -1 on failure)
+int write_all(int fd, const char *buffer, size_t length, off_t offset){
+    while(length > 0){
+        ssize_t written = pwrite(fd, buffer, length, offset);
+        if(written < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            return -1;
+        }
+        buffer += written;
+        length -= written;
+        offset += written;
+    }
+    return 0;
+}
+
+
+//write-behind for bulk copies: start writeback of the window just written, wait for the window before it
+//and drop both that window and the source pages from the page cache, so a large copy does not evict other data 
+void bulk_writeback(int fd_src, const int *fds, const int *errs, int count, off_t prev_start, off_t window_start, off_t window_end){
+
+    for(int i = 0; i < count; i++){
+        if(fds[i] < 0 || errs[i] != 0){
+            continue;
+        }
+        sync_file_range(fds[i], window_start, window_end - window_start, SYNC_FILE_RANGE_WRITE);
+        if(prev_start < window_start){
+            sync_file_range(fds[i], prev_start, window_start - prev_start, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+            posix_fadvise(fds[i], prev_start, window_start - prev_start, POSIX_FADV_DONTNEED);
+        }
+    }
+    posix_fadvise(fd_src, window_start, window_end - window_start, POSIX_FADV_DONTNEED);
+}
+
+
+//copy the data extents of [start, end) found with SEEK_DATA/SEEK_HOLE into every target that has not failed yet
+//bulk copies are written behind in BULK_WINDOW steps and kept out of the page cache 
+//(returns 0 when the source was read, -1 on a source read error; target write errors are stored in errs)
+int copy_range(int fd_src, const int *fds, int *errs, int count, off_t start, off_t end, int bulk){
+
+    char buffer[BUF_SIZE];
+    off_t pos = start;
+    off_t prev_window = start;  //written, writeback started 
+    off_t window = start;  //start of the window being written 
+    if(bulk){
+        posix_fadvise(fd_src, start, end - start, POSIX_FADV_SEQUENTIAL);
+    }
+
+    while(pos < end){
+        off_t data = lseek(fd_src, pos, SEEK_DATA);
+        off_t hole;
+        if(data < 0){
+            if(errno == ENXIO){
+                break;  //only a hole is left
+            }
+            //filesystem without SEEK_DATA support, treat everything as data 
+            data = pos;
+            hole = end;
+        } else{
+            if(data >= end){
+                break;
+            }
+            hole = lseek(fd_src, data, SEEK_HOLE);
+            if(hole < 0 || hole > end){
+                hole = end;
+            }
+        }
+
+        while(data < hole){
+            size_t chunk = (hole - data) < BUF_SIZE ? (size_t)(hole - data) : BUF_SIZE;
+            ssize_t bytes = pread(fd_src, buffer, chunk, data);
+            if(bytes < 0){
+                if(errno == EINTR){
+                    continue;
+                }
+                return -1;
+            }
+            if(bytes == 0){
+                return 0;  //source shrank while copying 
+            }
+            bucket_consume(&byte_bucket, bytes);
+            __atomic_add_fetch(&bytes_read, bytes, __ATOMIC_RELAXED);
+
+            //the chunk is read once and written to every target 
+            int alive = 0;
+            for(int i = 0; i < count; i++){
+                if(errs[i] == 0 && write_all(fds[i], buffer, bytes, data) == -1){
+                    errs[i] = errno ? errno : EIO;
+                }
+                alive += (errs[i] == 0);
+            }
+            if(alive == 0){
+                return 0;
+            }
+            data += bytes;
+
+            if(bulk && data - window >= BULK_WINDOW){
+                bulk_writeback(fd_src, fds, errs, count, prev_window, window, data);
+                prev_window = window;
+                window = data;
+            }
+        }
+        pos = hole;
+    }
+
+    //wait for the last windows too, so nothing written by this copy stays cached 
+    if(bulk){
+        bulk_writeback(fd_src, fds, errs, count, prev_window, window, end);
+        bulk_writeback(fd_src, fds, errs, count, window, end, end);
+    }
+    return 0;
+}
+
+
+//thread body of a parallel copy: copies the data extents of one range 
+void *copy_chunk_thread(void *arg){
+    copy_chunk *chunk = arg;
+    chunk->result = copy_range(chunk->fd_src, chunk->fds, chunk->errs, chunk->count, chunk->start, chunk->end, chunk->bulk);
+    chunk->saved_errno = errno;
+    return NULL;
+}
+
+
+//open a directory of the run for the *at() calls, so every later lookup below it resolves a single name 
+int open_dir(int base, const char *path){
+    return openat(base, path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+}
+
+
+//open a source file relative to the source directory (returns -1 with errno set, also when the directory could not be opened)
+int open_source(const char *name){
+    if(src_fd < 0){
+        errno = src_errno;
+        return -1;
+    }
+    return openat(src_fd, name, O_RDONLY | O_CLOEXEC);
+}
+
+
+//build the temporary name a file is written under before it is renamed over name in the same directory 
+int temp_name(const char *name, char *tmp, size_t size){
+    if(snprintf(tmp, size, ".%s.fss_part", name) >= (int)size){
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    return 0;
+}
+
+
+//copy a large file with several threads into temporary files that are renamed over the targets
+//(returns 0 when the source was read, -1 on a source error; per-target errors are stored in errs)
+int copy_file_parallel(int fd_src, const struct stat *st, const char *name, const int *trg_dirs, int count, int *errs){
+
+    char tmp[TEMP_NAME_LEN];
+    int fds[MAX_TARGETS];
+
+    //preallocate dense files; sparse files only get their size so holes are kept 
+    int sparse = (st->st_blocks * 512 < st->st_size);
+    int named = (temp_name(name, tmp, sizeof(tmp)) == 0);
+    for(int i = 0; i < count; i++){
+        fds[i] = -1;
+        if(!named || (fds[i] = openat(trg_dirs[i], tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0){
+            errs[i] = errno;
+            continue;
+        }
+        if(sparse || fallocate(fds[i], 0, 0, st->st_size) == -1){
+            if(ftruncate(fds[i], st->st_size) == -1){
+                errs[i] = errno;
+            }
+        }
+    }
+
+    //split the file into one aligned range per thread 
+    copy_chunk chunks[MAX_COPY_THREADS];
+    pthread_t threads[MAX_COPY_THREADS];
+    off_t per_thread = (st->st_size + copy_threads - 1) / copy_threads;
+    off_t chunk_size = (per_thread + CHUNK_ALIGN - 1) / CHUNK_ALIGN * CHUNK_ALIGN;
+    int started = 0;
+
+    for(int i = 0; i < copy_threads; i++){
+        off_t start = (off_t)i * chunk_size;
+        if(start >= st->st_size){
+            break;
+        }
+        chunks[i].fd_src = fd_src;
+        chunks[i].fds = fds;
+        chunks[i].count = count;
+        memcpy(chunks[i].errs, errs, count * sizeof(int));
+        chunks[i].start = start;
+        chunks[i].end = (start + chunk_size < st->st_size) ? start + chunk_size : st->st_size;
+        chunks[i].bulk = (bulk_threshold > 0 && st->st_size >= bulk_threshold);
+        chunks[i].result = 0;
+        if(pthread_create(&threads[i], NULL, copy_chunk_thread, &chunks[i]) != 0){
+            //copy the range in this thread if no more threads can be created
+            copy_chunk_thread(&chunks[i]);
+            threads[i] = 0;
+        }
+        started++;
+    }
+
+    int result = 0;
+    int saved = 0;
+    for(int i = 0; i < started; i++){
+        if(threads[i]){
+            pthread_join(threads[i], NULL);
+        }
+        if(chunks[i].result != 0){
+            result = -1;
+            saved = chunks[i].saved_errno;
+        }
+        for(int t = 0; t < count; t++){
+            if(errs[t] == 0 && chunks[i].errs[t] != 0){
+                errs[t] = chunks[i].errs[t];
+            }
+        }
+    }
+
+    //publish every complete copy atomically 
+    for(int i = 0; i < count; i++){
+        if(fds[i] < 0){
+            continue;
+        }
+        if(close(fds[i]) == -1 && errs[i] == 0){
+            errs[i] = errno;
+        }
+        if(result == 0 && errs[i] == 0 && renameat(trg_dirs[i], tmp, trg_dirs[i], name) == -1){
+            errs[i] = errno;
+        }
+        if(result != 0 || errs[i] != 0){
+            unlinkat(trg_dirs[i], tmp, 0);
+        }
+    }
+
+    errno = saved;
+    return result;
+}
+
+
+//copy a source file to the same name in one or more target directories, reading the source once 
+//(returns 1 if the source could be copied, 0 on failure; errs gets the errno of each failed target)
+//trg_paths name the target directories in messages 
+int copy_file(const char *name, const int *trg_dirs, const char **trg_paths, int count, int *errs, char *err_buf, int *errors){
+
+    //callers hold at most MAX_TARGETS targets; the bound keeps the descriptor array below in range 
+    if(count > MAX_TARGETS){
+        count = MAX_TARGETS;
+    }
+    for(int i = 0; i < count; i++){
+        errs[i] = 0;
+    }
+    files_done++;
+
+    int fd_src = open_source(name);
     if(fd_src < 0){
         //handle source file open error
-        char msg[256];
-        snprintf(msg, sizeof(msg), "Failed to open source: %s (%s)\n", src, strerror(errno));
+        char msg[PATH_MAX + 64];
+        snprintf(msg, sizeof(msg), "Failed to open source: %s/%s (%s)\n", src_path, name, strerror(errno));
         strncat(err_buf, msg, ERR_BUF_SIZE - strlen(err_buf) - 1);
         err_buf[ERR_BUF_SIZE - 1] = '\0';
+        for(int i = 0; i < count; i++){
+            errs[i] = errno ? errno : EIO;
+        }
+        (*errors)++;
+        return 0;
+    }
+
+    struct stat st;
+    int result;
+    if(fstat(fd_src, &st) == -1){
+        result = -1;
+    } else if(copy_threads > 1 && st.st_size >= parallel_threshold){
+        //large files are split into ranges copied concurrently 
+        result = copy_file_parallel(fd_src, &st, name, trg_dirs, count, errs);
+    } else{
+        int fds[MAX_TARGETS];
+        for(int i = 0; i < MAX_TARGETS; i++){
+            fds[i] = -1;
+        }
+        for(int i = 0; i < count; i++){
+            fds[i] = openat(trg_dirs[i], name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if(fds[i] < 0){
+                errs[i] = errno;
+            }
+        }
+
+        //copy only the allocated extents; skipped ranges stay holes in the freshly truncated targets 
+        int bulk = (bulk_threshold > 0 && st.st_size >= bulk_threshold);
+        result = copy_range(fd_src, fds, errs, count, 0, st.st_size, bulk);
+
+        for(int i = 0; i < count; i++){
+            if(fds[i] < 0){
+                continue;
+            }
+            //restore the logical size so trailing holes are preserved 
+            if(errs[i] == 0 && ftruncate(fds[i], st.st_size) == -1){
+                errs[i] = errno;
+            }
+            close(fds[i]);
+        }
+    }
+    close(fd_src);
+
+    if(result != 0){
+        char msg[PATH_MAX + 64];
+        snprintf(msg, sizeof(msg), "Read error on: %s/%s (%s)\n", src_path, name, strerror(errno));
+        append_error(err_buf, msg);
         (*errors)++;
         return 0;
     }
 
-    int fd_trg = open(trg, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-    if(fd_trg < 0){
-        //handle target file open error 
-        char msg[256];
-        snprintf(msg, sizeof(msg), "Failed to open destination: %s (%s)\n", trg, strerror(errno));
-        strncat(err_buf, msg, ERR_BUF_SIZE - strlen(err_buf) - 1);
-        err_buf[ERR_BUF_SIZE - 1] = '\0';
-        close(fd_src);
-        (*errors)++;
-        return 0;
+    for(int i = 0; i < count; i++){
+        if(errs[i] != 0){
+            //handle write error 
+            char msg[PATH_MAX + 64];
+            snprintf(msg, sizeof(msg), "Write error on: %s/%s (%s)\n", trg_paths[i], name, strerror(errs[i]));
+            append_error(err_buf, msg);
+            (*errors)++;
+        }
+    }
+    return 1;
+}
+
+
+//check whether every target excludes a name 
+int excluded_everywhere(const char *name){
+    for(int i = 0; i < target_count; i++){
+        if(!filter_excluded(&target_filters[i], name)){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+int hash_file(int dir, const char *name, unsigned long long *hash_out);  //defined with the verify code 
+
+
+//create (if needed) and open a dedup store directory relative to base; it must be writable and on the filesystem of the target 
+int make_store(int base, const char *path, const struct stat *trg_st){
+    if(mkdirat(base, path, 0700) == -1 && errno != EEXIST){
+        return -1;
+    }
+    int fd = open_dir(base, path);
+    struct stat st;
+    if(fd >= 0 && (fstat(fd, &st) == -1 || st.st_dev != trg_st->st_dev || faccessat(fd, ".", W_OK, 0) == -1)){
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+//find the highest writable directory from the target up to the mount point of its filesystem by walking ".." 
+//from the open target directory; the system root is never used (returns an open directory or -1)
+int store_parent(const target_dir *target, const struct stat *trg_st){
+
+    int best = -1;
+    int dir = open_dir(target->fd, ".");
+    while(dir >= 0){
+        struct stat st, parent_st;
+        int parent = open_dir(dir, "..");
+        int top = (parent < 0 || fstat(dir, &st) == -1 || fstat(parent, &parent_st) == -1 || parent_st.st_dev != trg_st->st_dev);
+        int root = (!top && parent_st.st_ino == st.st_ino);  //".." of the root is the root itself 
+        if(!root && faccessat(dir, ".", W_OK, 0) == 0){
+            if(best >= 0){
+                close(best);
+            }
+            best = dir;
+        } else{
+            close(dir);
+        }
+        if(top || root){
+            if(parent >= 0){
+                close(parent);
+            }
+            break;
+        }
+        dir = parent;
+    }
+    return best;
+}
+
+
+//locate the dedup store of a target (returns 0 if it can be used): the dedup_store directory of the pair if one is set, 
+//otherwise DEDUP_STORE in the highest writable directory from the mount point of the target filesystem down to the 
+//target itself, so the targets of every pair on that filesystem share one store 
+int open_store(target_dir *target){
+
+    if(target->store_state != 0){
+        return target->store_state > 0 ? 0 : -1;
+    }
+    target->store_state = -1;
+
+    struct stat trg_st;
+    int fd = -1;
+    if(target->fd >= 0 && fstat(target->fd, &trg_st) == 0){
+        if(target->store_dir){
+            fd = make_store(AT_FDCWD, target->store_dir, &trg_st);
+        } else{
+            int parent = store_parent(target, &trg_st);
+            if(parent >= 0){
+                fd = make_store(parent, DEDUP_STORE, &trg_st);
+                close(parent);
+            }
+        }
+    }
+
+    struct stat store_st;
+    if(fd < 0 || fstat(fd, &store_st) == -1){
+        fprintf(stderr, "No dedup store for %s, its files are copied\n", target->dir);
+        if(fd >= 0){
+            close(fd);
+        }
+        return -1;
+    }
+    target->store_fd = fd;
+    target->store_dev = store_st.st_dev;
+    target->store_ino = store_st.st_ino;
+    target->store_state = 1;
+    return 0;
+}
+
+
+//check whether two targets of the run use the same dedup store 
+int same_store(const target_dir *a, const target_dir *b){
+    return a->store_state > 0 && b->store_state > 0 && a->store_dev == b->store_dev && a->store_ino == b->store_ino;
+}
+
+
+//compare the contents of two files of equal size (returns 1 if they are identical)
+int same_content(int fd_a, int dir_b, const char *name_b){
+
+    int fd_b = openat(dir_b, name_b, O_RDONLY | O_CLOEXEC);
+    int same = (fd_a >= 0 && fd_b >= 0);
+    char buf_a[BUF_SIZE], buf_b[BUF_SIZE];
+    off_t offset = 0;
+
+    while(same){
+        ssize_t bytes = pread(fd_a, buf_a, sizeof(buf_a), offset);
+        if(bytes <= 0){
+            same = (bytes == 0 && read(fd_b, buf_b, 1) == 0);
+            break;
+        }
+        bucket_consume(&byte_bucket, bytes);
+        __atomic_add_fetch(&bytes_read, bytes, __ATOMIC_RELAXED);
+        offset += bytes;
+        ssize_t got = 0;
+        while(got < bytes){
+            ssize_t n = read(fd_b, buf_b + got, bytes - got);
+            if(n <= 0){
+                break;
+            }
+            got += n;
+        }
+        same = (got == bytes && memcmp(buf_a, buf_b, bytes) == 0);
+    }
+
+    if(fd_b >= 0){
+        close(fd_b);
+    }
+    return same;
+}
+
+
+//make dst share the data of src: a reflink clone, or a hard link (returns 0 on success)
+int share_file(int mode, int src_dir, const char *src, int dst_dir, const char *dst){
+
+    if(mode == DEDUP_LINK){
+        if(linkat(src_dir, src, dst_dir, dst, 0) == -1){
+            return -1;
+        }
+        //the shared inode gets a current mtime, so verify does not take the new target for stale 
+        utimensat(dst_dir, dst, NULL, 0);
+        return 0;
+    }
+
+    int fd_src = openat(src_dir, src, O_RDONLY | O_CLOEXEC);
+    if(fd_src < 0){
+        return -1;
+    }
+    int fd_dst = openat(dst_dir, dst, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd_dst < 0){
+        close(fd_src);
+        return -1;
+    }
+    int result = ioctl(fd_dst, FICLONE, fd_src);
+    close(fd_dst);
+    close(fd_src);
+    if(result == -1){
+        unlinkat(dst_dir, dst, 0);
+    }
+    return result;
+}
+
+
+//create a target file from the stored copy under a temporary name and rename it over the target 
+//(returns 0 on success, -1 if the file has to be copied instead)
+int dedup_from_store(target_dir *target, const char *blob, const struct stat *blob_st, const char *name){
+
+    //a target that already is the stored copy only gets a current mtime: renaming another link of the 
+    //same inode over it would do nothing and leave the temporary name behind 
+    struct stat trg_st;
+    if(fstatat(target->fd, name, &trg_st, 0) == 0 && trg_st.st_dev == blob_st->st_dev && trg_st.st_ino == blob_st->st_ino){
+        return utimensat(target->fd, name, NULL, 0);
+    }
+
+    char tmp[TEMP_NAME_LEN];
+    if(temp_name(name, tmp, sizeof(tmp)) == -1){
+        return -1;
+    }
+    unlinkat(target->fd, tmp, 0);
+    if(share_file(target->dedup, target->store_fd, blob, target->fd, tmp) == -1){
+        //without reflinks on this filesystem the store is not used for the rest of the run 
+        if(target->dedup == DEDUP_CLONE && (errno == EOPNOTSUPP || errno == EINVAL || errno == EXDEV || errno == ENOTTY)){
+            target->store_state = -1;
+        }
+        return -1;
+    }
+    int result = renameat(target->fd, tmp, target->fd, name);
+    unlinkat(target->fd, tmp, 0);  //still there if the target became the same inode meanwhile 
+    return result;
+}
+
+
+//add a freshly copied target file to the store under its content hash; the entry is a hard link in both modes, 
+//so its link count tells whether any target still uses it 
+void dedup_insert(const target_dir *target, const char *blob, const char *name){
+    char tmp[64];
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", blob, (int)getpid());
+    unlinkat(target->store_fd, tmp, 0);
+    if(linkat(target->fd, name, target->store_fd, tmp, 0) == 0){
+        renameat(target->store_fd, tmp, target->store_fd, blob);
+        unlinkat(target->store_fd, tmp, 0);
+    }
+}
+
+
+//remove the store entries that no target links to any more (link count 1), temporary entries of 
+//interrupted runs included (returns the number of removed entries)
+int dedup_collect(const target_dir *target){
+
+    int list_fd = open_dir(target->store_fd, ".");
+    DIR *dir = list_fd >= 0 ? fdopendir(list_fd) : NULL;
+    if(!dir){
+        if(list_fd >= 0){
+            close(list_fd);
+        }
+        return 0;
+    }
+
+    int removed = 0;
+    struct dirent *entry;
+    while((entry = readdir(dir)) != NULL){
+        struct stat st;
+        if(entry->d_name[0] != '.' && fstatat(target->store_fd, entry->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0 &&
+           S_ISREG(st.st_mode) && st.st_nlink == 1 && unlinkat(target->store_fd, entry->d_name, 0) == 0){
+            removed++;
+        }
+    }
+    closedir(dir);
+    return removed;
+}
+
+
+//read until the buffer is full or the file ends (returns the bytes read, -1 on error)
+ssize_t read_full(int fd, char *buffer, size_t size){
+    size_t total = 0;
+    while(total < size){
+        ssize_t bytes = read(fd, buffer + total, size - total);
+        if(bytes < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            return -1;
+        }
+        if(bytes == 0){
+            break;
+        }
+        total += bytes;
+    }
+    return total;
+}
+
+
+//read the header of a compressed file (returns -1 if it cannot be read or is not compressed)
+int read_stored_header(int dir, const char *name, fsz_header *header){
+    char buffer[FSZ_HEADER_SIZE];
+    int fd = openat(dir, name, O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        return -1;
+    }
+    ssize_t bytes = read_full(fd, buffer, sizeof(buffer));
+    close(fd);
+    if(bytes != FSZ_HEADER_SIZE){
+        return -1;
+    }
+    return fsz_read_header(buffer, header);
+}
+
+
+//stat a target file; a compressed file reports the size and mtime of its source from the stored header, 
+//so the size/mtime comparisons of verify and snapshots work on both kinds of targets 
+int stored_stat(const target_dir *target, const char *name, struct stat *st){
+    if(fstatat(target->fd, name, st, 0) == -1){
+        return -1;
+    }
+    fsz_header header;
+    if(target->compress && S_ISREG(st->st_mode) && read_stored_header(target->fd, name, &header) == 0){
+        st->st_size = header.size;
+        st->st_mtim.tv_sec = header.mtime_sec;
+        st->st_mtim.tv_nsec = header.mtime_nsec;
+    }
+    return 0;
+}
+
+
+//check whether a compressed file already holds the current version of a source file 
+int stored_current(int dir, const char *name, const struct stat *src_st){
+    fsz_header header;
+    return read_stored_header(dir, name, &header) == 0 && header.size == (unsigned long long)src_st->st_size &&
+           header.mtime_sec == src_st->st_mtim.tv_sec && header.mtime_nsec == src_st->st_mtim.tv_nsec;
+}
+
+
+//compress a source file into a temporary file that is renamed over the same name in trg_dir 
+//(returns 0 or the errno of the failure; the bytes read and written are added to the target counters)
+int store_compressed(target_dir *target, int trg_dir, const char *name){
+
+    char tmp[TEMP_NAME_LEN];
+    if(temp_name(name, tmp, sizeof(tmp)) == -1){
+        return errno;
+    }
+    int fd_src = open_source(name);
+    if(fd_src < 0){
+        return errno;
+    }
+    struct stat st;
+    int fd = -1;
+    if(fstat(fd_src, &st) == -1 || (fd = openat(trg_dir, tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0){
+        int err = errno;
+        close(fd_src);
+        return err;
+    }
+
+    char raw[FSZ_BLOCK_SIZE];
+    char out[FSZ_BOUND(FSZ_BLOCK_SIZE)];
+    off_t offset = FSZ_HEADER_SIZE;
+    unsigned long long total = 0;
+    int err = 0;
+    ssize_t bytes;
+    while((bytes = read_full(fd_src, raw, sizeof(raw))) > 0){
+        bucket_consume(&byte_bucket, bytes);
+        __atomic_add_fetch(&bytes_read, bytes, __ATOMIC_RELAXED);
+        int length = fsz_write_block(raw, bytes, out);
+        if(write_all(fd, out, length, offset) == -1){
+            err = errno;
+            break;
+        }
+        offset += length;
+        total += bytes;
+    }
+    if(bytes < 0 && err == 0){
+        err = errno;
+    }
+
+    //the header goes in last with the bytes actually read; its mtime is the one from before the read, 
+    //so a file changed meanwhile looks stale to the next comparison 
+    if(err == 0){
+        char header_buf[FSZ_HEADER_SIZE];
+        fsz_header header = {total, st.st_mtim.tv_sec, st.st_mtim.tv_nsec, st.st_mode & 07777};
+        fsz_write_header(header_buf, &header);
+        if(write_all(fd, header_buf, sizeof(header_buf), 0) == -1){
+            err = errno;
+        }
+    }
+    if(close(fd) == -1 && err == 0){
+        err = errno;
+    }
+    close(fd_src);
+
+    struct timespec times[2] = {{0, UTIME_OMIT}, st.st_mtim};
+    if(err == 0 && (utimensat(trg_dir, tmp, times, 0) == -1 || renameat(trg_dir, tmp, trg_dir, name) == -1)){
+        err = errno;
+    }
+    if(err != 0){
+        unlinkat(trg_dir, tmp, 0);
+        return err;
+    }
+    target->raw_bytes += total;
+    target->stored_bytes += offset;
+    return 0;
+}
+
+
+//bring a compressed target up to date with a source file: files whose stored size and mtime match are kept 
+//(returns 0 or the errno of the failure)
+int update_compressed(target_dir *target, const char *name, const struct stat *src_st){
+    if(src_st && stored_current(target->fd, name, src_st)){
+        return 0;
+    }
+    return store_compressed(target, target->fd, name);
+}
+
+
+//count a failed file on a target and describe it in the error buffer 
+void target_failed(target_dir *target, const char *what, const char *name, int err, char *err_buf, int *errors){
+    char msg[PATH_MAX + 64];
+    snprintf(msg, sizeof(msg), "%s: %s/%s (%s)\n", what, target->dir, name, strerror(err));
+    append_error(err_buf, msg);
+    target->failed++;
+    (*errors)++;
+}
+
+
+//copy one source file to every target and update the per-target counters (returns the number of failed targets)
+//targets with a dedup store get the file from the store when its content is already there, 
+//compressed targets are written on their own 
+int copy_to_targets(const char *filename, char *err_buf, int *errors){
+
+    char blob[MAX_TARGETS][64];  //"<hash>-<size>" in the dedup store, empty if not stored 
+    int trg_dirs[MAX_TARGETS];
+    const char *trg_paths[MAX_TARGETS];
+    int owner[MAX_TARGETS];
+    int errs[MAX_TARGETS];
+    int count = 0;
+    int failed = 0;
+
+    //targets whose rules exclude the name are skipped, neither copied nor failed 
+    for(int i = 0; i < target_count; i++){
+        if(filter_excluded(&target_filters[i], filename)){
+            continue;
+        }
+        if(targets[i].fd < 0){
+            target_failed(&targets[i], "Write error on", filename, targets[i].fd_errno, err_buf, errors);
+            failed++;
+            continue;
+        }
+        owner[count++] = i;
+    }
+    if(count == 0){
+        return failed;
+    }
+
+    //the source is opened and hashed once for all dedup targets, and a stored copy is compared once per store 
+    int hashed = 0;  //1 hashed, -1 not eligible 
+    unsigned long long hash = 0;
+    struct stat src_st;
+    int src_ok = (src_fd >= 0 && fstatat(src_fd, filename, &src_st, 0) == 0);
+    int verified = -1;  //target whose store copy was already compared with this source 
+    int remaining = 0;
+    for(int c = 0; c < count; c++){
+        target_dir *target = &targets[owner[c]];
+        int keep = 1;
+        blob[c][0] = '\0';
+        if(target->compress){
+            int err = update_compressed(target, filename, src_ok ? &src_st : NULL);
+            if(err == 0){
+                target->copied++;
+            } else{
+                target_failed(target, "Compress error on", filename, err, err_buf, errors);
+                failed++;
+            }
+            keep = 0;
+        } else if(target->dedup != DEDUP_OFF){
+            if(hashed == 0){
+                hashed = (src_ok && src_st.st_size >= DEDUP_MIN_SIZE && hash_file(src_fd, filename, &hash) == 0) ? 1 : -1;
+            }
+            if(hashed > 0 && open_store(target) == 0){
+                snprintf(blob[c], sizeof(blob[c]), "%016llx-%lld", hash, (long long)src_st.st_size);
+                struct stat blob_st;
+                int fd_src = -1;
+                if(fstatat(target->store_fd, blob[c], &blob_st, 0) == 0 && blob_st.st_size == src_st.st_size &&
+                   ((verified >= 0 && same_store(&targets[verified], target)) ||
+                    ((fd_src = open_source(filename)) >= 0 && same_content(fd_src, target->store_fd, blob[c]))) &&
+                   dedup_from_store(target, blob[c], &blob_st, filename) == 0){
+                    verified = owner[c];
+                    target->copied++;
+                    target->deduped++;
+                    target->dedup_bytes += src_st.st_size;
+                    blob[c][0] = '\0';
+                    keep = 0;
+                }
+                if(fd_src >= 0){
+                    close(fd_src);
+                }
+                if(target->store_state < 0){
+                    blob[c][0] = '\0';
+                }
+            }
+
+            //a target linked to the store is replaced, never written in place, so the store and other links keep their data 
+            struct stat trg_st;
+            if(keep && fstatat(target->fd, filename, &trg_st, 0) == 0 && trg_st.st_nlink > 1){
+                unlinkat(target->fd, filename, 0);
+            }
+        }
+        if(keep){
+            if(remaining != c){
+                strcpy(blob[remaining], blob[c]);
+            }
+            trg_dirs[remaining] = target->fd;
+            trg_paths[remaining] = target->dir;
+            owner[remaining++] = owner[c];
+        }
+    }
+    if(remaining == 0){
+        files_done++;
+        return failed;
+    }
+
+    copy_file(filename, trg_dirs, trg_paths, remaining, errs, err_buf, errors);
+
+    for(int c = 0; c < remaining; c++){
+        if(errs[c] == 0){
+            targets[owner[c]].copied++;
+            if(blob[c][0] != '\0'){
+                dedup_insert(&targets[owner[c]], blob[c], filename);
+            }
+        } else{
+            targets[owner[c]].failed++;
+            failed++;
+        }
+    }
+    return failed;
+}
+
+
+//delete one file from every target (returns the number of failed targets)
+int delete_from_targets(const char *filename, char *err_buf){
+
+    int failed = 0;
+    int errors = 0;
+    files_done++;
+    for(int i = 0; i < target_count; i++){
+        if(filter_excluded(&target_filters[i], filename)){
+            continue;
+        }
+        //a target directory that does not exist has nothing to delete 
+        int err = targets[i].fd < 0 ? targets[i].fd_errno : (unlinkat(targets[i].fd, filename, 0) == 0 ? 0 : errno);
+        if(err != 0 && err != ENOENT){
+            target_failed(&targets[i], "Failed to delete", filename, err, err_buf, &errors);
+            failed++;
+        }
+    }
+    return failed;
+}
+
+
+//print one result line per target so the manager can track each target separately, 
+//and the amount of work done so the manager can measure throughput 
+void print_target_reports(){
+    printf("WORK: %lld %ld\n", bytes_read, files_done);
+    const char *trace_id = getenv("FSS_TRACE_ID");
+    if(trace_id){
+        printf("TRACE: %s %lld %lld\n", trace_id, start_us, monotonic_us());
+    }
+    for(int i = 0; i < target_count; i++){
+        const char *status = targets[i].failed == 0 ? "SUCCESS" : (targets[i].copied > 0 ? "PARTIAL" : "ERROR");
+        //the fourth column holds the pruned files, or the linked files of a snapshot 
+        printf("TARGET: %s %d %d %d %s\n", status, targets[i].copied, targets[i].failed, targets[i].pruned + targets[i].linked, targets[i].dir);
+        if(targets[i].deduped > 0){
+            printf("DEDUP: %d %lld %s\n", targets[i].deduped, targets[i].dedup_bytes, targets[i].dir);
+        }
+        if(targets[i].raw_bytes > 0){
+            printf("COMPRESS: %lld %lld %s\n", targets[i].raw_bytes, targets[i].stored_bytes, targets[i].dir);
+        }
+    }
+}
+
+
+//compare two entry names for qsort
+int compare_names(const void *a, const void *b){
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+
+//free a name list returned by list_regular_files
+void free_name_list(char **names, int count){
+    for(int i = 0; i < count; i++){
+        free(names[i]);
+    }
+    free(names);
+}
+
+
+//list the regular files of a directory with getdents64, sorted by name (returns count or -1 on failure)
+//the listing reads a fresh descriptor, so the one of the run keeps no directory offset 
+int list_regular_files(int dir, char ***names_out){
+
+    if(dir < 0){
+        errno = EBADF;
+        return -1;
+    }
+    int dir_fd = open_dir(dir, ".");
+    if(dir_fd < 0){
+        return -1;
+    }
+
+    char buffer[DIRENT_BUF_SIZE];
+    char **names = NULL;
+    int count = 0, capacity = 0;
+    long nread;
+
+    while((nread = syscall(SYS_getdents64, dir_fd, buffer, sizeof(buffer))) > 0){
+        long pos = 0;
+        while(pos < nread){
+            struct linux_dirent64 *entry = (struct linux_dirent64 *)(buffer + pos);
+            pos += entry->d_reclen;
+
+            if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0){
+                continue;
+            }
+
+            //some filesystems do not fill d_type, fall back to fstatat
+            int regular = (entry->d_type == DT_REG);
+            if(entry->d_type == DT_UNKNOWN){
+                struct stat st;
+                regular = (fstatat(dir_fd, entry->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISREG(st.st_mode));
+            }
+            if(!regular){
+                continue;
+            }
+
+            if(count == capacity){
+                capacity = capacity ? capacity * 2 : 64;
+                char **grown = realloc(names, capacity * sizeof(char *));
+                if(!grown){
+                    free_name_list(names, count);
+                    close(dir_fd);
+                    return -1;
+                }
+                names = grown;
+            }
+            names[count] = strdup(entry->d_name);
+            if(!names[count]){
+                free_name_list(names, count);
+                close(dir_fd);
+                return -1;
+            }
+            count++;
+        }
+    }
+
+    close(dir_fd);
+    if(nread < 0){
+        free_name_list(names, count);
+        return -1;
+    }
+
+    qsort(names, count, sizeof(char *), compare_names);
+    *names_out = names;
+    return count;
+}
+
+
+//remove target files that do not exist in source, using a single merge pass over both sorted listings 
+//excluded target files are left alone 
+int prune_target(char **src_names, int src_count, const target_dir *target, const filter_set *filter, char *err_buf, int *errors){
+
+    char **trg_names = NULL;
+    int trg_count = list_regular_files(target->fd, &trg_names);
+    if(trg_count < 0){
+        char msg[PATH_MAX + 64];
+        snprintf(msg, sizeof(msg), "Cannot list target: %s (%s)\n", target->dir, strerror(target->fd < 0 ? target->fd_errno : errno));
+        append_error(err_buf, msg);
+        (*errors)++;
+        return 0;
+    }
+
+    int pruned = 0;
+    int i = 0, j = 0;
+    while(j < trg_count){
+        int cmp = (i < src_count) ? strcmp(src_names[i], trg_names[j]) : 1;
+        if(cmp < 0){
+            i++;
+        } else if(cmp == 0){
+            i++;
+            j++;
+        } else if(filter_excluded(filter, trg_names[j])){
+            j++;
+        } else{
+            //target entry has no source counterpart 
+            bucket_consume(&file_bucket, 1);
+            if(unlinkat(target->fd, trg_names[j], 0) == 0){
+                pruned++;
+            } else{
+                char msg[PATH_MAX + 64];
+                snprintf(msg, sizeof(msg), "Failed to prune: %s/%s (%s)\n", target->dir, trg_names[j], strerror(errno));
+                append_error(err_buf, msg);
+                (*errors)++;
+            }
+            j++;
+        }
+    }
+
+    free_name_list(trg_names, trg_count);
+    return pruned;
+}
+
+
+//perform a full synchronization of all regular files from source to every target (mirror targets also lose extra files)
+void perform_full_sync(){
+
+    int list_fd = src_fd >= 0 ? open_dir(src_fd, ".") : (errno = src_errno, -1);
+    DIR *src = list_fd >= 0 ? fdopendir(list_fd) : NULL;
+    if(!src){
+        //report failure to open source directory 
+        printf("EXEC_REPORT_START\nSTATUS: ERROR\nDETAILS: Cannot open source dir %s (%s)\nEXEC_REPORT_END\n", src_path, strerror(errno));
+        if(list_fd >= 0){
+            close(list_fd);
+        }
+        return;
+    }
+
+    struct dirent *entry;
+    int copied = 0, errors = 0;
+    char err_buf[ERR_BUF_SIZE] = "";
+
+    while((entry = readdir(src)) != NULL){
+        if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0){
+            continue;
+        }
+        if(excluded_everywhere(entry->d_name)){
+            continue;  //rejected before any system call 
+        }
+
+        struct stat st;
+        if (fstatat(src_fd, entry->d_name, &st, 0) == -1 || !S_ISREG(st.st_mode)){
+            //skip non-regular files 
+            continue;
+        }
+        bucket_consume(&file_bucket, 1);
+        if (copy_to_targets(entry->d_name, err_buf, &errors) < target_count) {
+            copied++;
+        }
+    }
+
+    closedir(src);
+
+    //list the source once and merge it against every mirror target 
+    int mirror = 0, pruned = 0;
+    for(int i = 0; i < target_count; i++){
+        mirror |= targets[i].mirror;
+    }
+    if(mirror){
+        char **src_names = NULL;
+        int src_count = list_regular_files(src_fd, &src_names);
+        if(src_count < 0){
+            char msg[PATH_MAX + 64];
+            snprintf(msg, sizeof(msg), "Cannot list source: %s (%s)\n", src_path, strerror(errno));
+            append_error(err_buf, msg);
+            errors++;
+        } else{
+            for(int i = 0; i < target_count; i++){
+                if(targets[i].mirror){
+                    int before = errors;
+                    targets[i].pruned = prune_target(src_names, src_count, &targets[i], &target_filters[i], err_buf, &errors);
+                    targets[i].failed += errors - before;
+                    pruned += targets[i].pruned;
+                }
+            }
+            free_name_list(src_names, src_count);
+        }
+    }
+
+    //every target file was just rewritten or linked, so store entries nothing links to are dropped, once per store
+    for(int i = 0; i < target_count; i++){
+        int first = (targets[i].store_state > 0);
+        for(int j = 0; j < i && first; j++){
+            first = !same_store(&targets[j], &targets[i]);
+        }
+        if(first){
+            dedup_collect(&targets[i]);
+        }
+    }
+
+    //determine final status 
+    const char *status;
+    if(errors == 0){
+        status = "SUCCESS";
+    }
+    else if(copied > 0){
+        status = "PARTIAL";
+    }
+    else{
+        status = "ERROR";
+    }
+
+    //print final EXEC_REPORT
+    printf("EXEC_REPORT_START\n");
+    printf("STATUS: %s\n", status);
+    if(mirror){
+        printf("DETAILS: %d files copied, %d failed, %d pruned\n", copied, errors, pruned);
+    } else{
+        printf("DETAILS: %d files copied, %d failed\n", copied, errors);
+    }
+    print_target_reports();
+    if(strlen(err_buf) > 0){
+        printf("ERRORS: %s", err_buf);
+    }
+        
+    printf("EXEC_REPORT_END\n");
+}
+
+
+//apply a list of "<operation> <filename>" entries read from a file or "-" (stdin) and print one aggregated report
+void perform_batch(const char *list_path){
+
+    FILE *list = (strcmp(list_path, "-") == 0) ? stdin : fopen(list_path, "r");
+    if(!list){
+        printf("EXEC_REPORT_START\nSTATUS: ERROR\nDETAILS: Cannot open batch list %s (%s)\nEXEC_REPORT_END\n", list_path, strerror(errno));
+        return;
+    }
+
+    int processed = 0, failed = 0;
+    char err_buf[ERR_BUF_SIZE] = "";
+    char line[NAME_MAX + 32];
+    static char failed_entries[MAX_FAILED_LINES][NAME_MAX + 32];  //listed in the report so the manager can retry them 
+
+    while(fgets(line, sizeof(line), list)){
+        char operation[16];
+        char filename[NAME_MAX + 1];
+        if(sscanf(line, "%15s %255[^\n]", operation, filename) != 2){
+            continue;
+        }
+        processed++;
+
+        int entry_failed = 0;
+        if(strcmp(operation, "ADDED") == 0 || strcmp(operation, "MODIFIED") == 0){
+            int errors = 0;
+            entry_failed = (copy_to_targets(filename, err_buf, &errors) > 0);
+        } else if(strcmp(operation, "DELETED") == 0){
+            entry_failed = (delete_from_targets(filename, err_buf) > 0);
+        } else{
+            char msg[NAME_MAX + 64];
+            snprintf(msg, sizeof(msg), "Unsupported operation %s for: %s\n", operation, filename);
+            append_error(err_buf, msg);
+            entry_failed = 1;
+        }
+        if(entry_failed){
+            if(failed < MAX_FAILED_LINES){
+                snprintf(failed_entries[failed], sizeof(failed_entries[failed]), "%s %s", operation, filename);
+            }
+            failed++;
+        }
+    }
+
+    if(list != stdin){
+        fclose(list);
+    }
+
+    const char *status;
+    if(failed == 0){
+        status = "SUCCESS";
+    } else if(failed < processed){
+        status = "PARTIAL";
+    } else{
+        status = "ERROR";
+    }
+
+    printf("EXEC_REPORT_START\n");
+    printf("STATUS: %s\n", status);
+    printf("DETAILS: %d files processed, %d failed\n", processed, failed);
+    print_target_reports();
+    for(int i = 0; i < failed && i < MAX_FAILED_LINES; i++){
+        printf("FAILED: %s\n", failed_entries[i]);
+    }
+    if(strlen(err_buf) > 0){
+        printf("ERRORS: %s", err_buf);
+    }
+    printf("EXEC_REPORT_END\n");
+}
+
+
+//find the newest finished snapshot in a snapshot directory (returns 1 and its name, 0 if there is none)
+//snapshot names are timestamps, so the newest one sorts last; names starting with '.' are unfinished 
+int latest_snapshot(int snap_root, char *name_out, size_t size){
+
+    int list_fd = open_dir(snap_root, ".");
+    DIR *dir = list_fd >= 0 ? fdopendir(list_fd) : NULL;
+    if(!dir){
+        if(list_fd >= 0){
+            close(list_fd);
+        }
+        return 0;
+    }
+
+    int found = 0;
+    struct dirent *entry;
+    while((entry = readdir(dir)) != NULL){
+        if(entry->d_name[0] == '.'){
+            continue;
+        }
+        if(!found || strcmp(entry->d_name, name_out) > 0){
+            strncpy(name_out, entry->d_name, size - 1);
+            name_out[size - 1] = '\0';
+            found = 1;
+        }
+    }
+    closedir(dir);
+    return found;
+}
+
+
+//open (creating it if needed) the snapshot root "<name>.snapshots" of a target in the parent directory of the target, 
+//which is opened once so the name is resolved relative to it (returns 0 on success, -1 with errno set)
+int open_snapshot_root(const target_dir *target, int *snap_fd){
+
+    //split the target path into its parent and last name; trailing slashes are ignored 
+    size_t length = strlen(target->dir);
+    while(length > 1 && target->dir[length - 1] == '/'){
+        length--;
+    }
+    size_t start = length;
+    while(start > 0 && target->dir[start - 1] != '/'){
+        start--;
+    }
+    char name[NAME_MAX + 1];
+    if(length - start + sizeof(".snapshots") > sizeof(name) || length == start){
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memcpy(name, target->dir + start, length - start);
+    strcpy(name + (length - start), ".snapshots");
+
+    int parent;
+    if(start == 0){
+        parent = open_dir(AT_FDCWD, ".");
+    } else{
+        char *parent_path = strndup(target->dir, start);
+        parent = parent_path ? open_dir(AT_FDCWD, parent_path) : -1;
+        free(parent_path);
+    }
+    if(parent < 0){
+        return -1;
+    }
+    if(mkdirat(parent, name, 0755) == -1 && errno != EEXIST){
+        int err = errno;
+        close(parent);
+        errno = err;
+        return -1;
+    }
+    *snap_fd = open_dir(parent, name);
+    int err = errno;
+    close(parent);
+    errno = err;
+    return *snap_fd >= 0 ? 0 : -1;
+}
+
+
+//create a point-in-time snapshot of the source next to every target, in <target>.snapshots/<timestamp>
+//files unchanged since the previous snapshot (same size and mtime) are hard-linked to it, only changed files are copied 
+void perform_snapshot(){
+
+    char err_buf[ERR_BUF_SIZE] = "";
+    int errors = 0;
+
+    char **names = NULL;
+    int count = list_regular_files(src_fd, &names);
+    if(count < 0){
+        printf("EXEC_REPORT_START\nSTATUS: ERROR\nDETAILS: Cannot open source dir %s (%s)\nEXEC_REPORT_END\n", src_path, strerror(src_fd < 0 ? src_errno : errno));
+        return;
+    }
+
+    char stamp[32];
+    time_t now = time(NULL);
+    struct tm tm_now;
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime_r(&now, &tm_now));
+
+    //per target: the snapshot root, the unfinished snapshot being filled, its final name and the previous snapshot 
+    char *snap_path[MAX_TARGETS];  //"<target>.snapshots", for messages only 
+    char work_name[MAX_TARGETS][80];
+    char final_name[MAX_TARGETS][64];
+    int snap_fd[MAX_TARGETS];
+    int work_fd[MAX_TARGETS];
+    int prev_fd[MAX_TARGETS];
+    const char *work_paths[MAX_TARGETS];
+
+    for(int i = 0; i < target_count; i++){
+        char prev_name[NAME_MAX + 1];
+        char msg[2 * PATH_MAX];
+
+        snap_fd[i] = work_fd[i] = prev_fd[i] = -1;
+        snap_path[i] = malloc(strlen(targets[i].dir) + sizeof(".snapshots"));
+        if(snap_path[i]){
+            sprintf(snap_path[i], "%s.snapshots", targets[i].dir);
+        }
+        work_paths[i] = snap_path[i] ? snap_path[i] : targets[i].dir;
+        if(open_snapshot_root(&targets[i], &snap_fd[i]) == -1){
+            snprintf(msg, sizeof(msg), "Cannot create snapshot dir: %s.snapshots (%s)\n", targets[i].dir, strerror(errno));
+            append_error(err_buf, msg);
+            targets[i].failed++;
+            errors++;
+            continue;
+        }
+        if(latest_snapshot(snap_fd[i], prev_name, sizeof(prev_name))){
+            prev_fd[i] = open_dir(snap_fd[i], prev_name);
+        }
+
+        //two snapshots within the same second get a counter suffix 
+        struct stat st;
+        strcpy(final_name[i], stamp);
+        for(int n = 1; fstatat(snap_fd[i], final_name[i], &st, AT_SYMLINK_NOFOLLOW) == 0; n++){
+            snprintf(final_name[i], sizeof(final_name[i]), "%s-%d", stamp, n);
+        }
+        snprintf(work_name[i], sizeof(work_name[i]), ".%s.tmp", final_name[i]);
+        if(mkdirat(snap_fd[i], work_name[i], 0755) == -1 || (work_fd[i] = open_dir(snap_fd[i], work_name[i])) < 0){
+            snprintf(msg, sizeof(msg), "Cannot create snapshot: %s/%s (%s)\n", work_paths[i], work_name[i], strerror(errno));
+            append_error(err_buf, msg);
+            targets[i].failed++;
+            errors++;
+            continue;
+        }
+    }
+
+    int copied = 0;
+    for(int k = 0; k < count; k++){
+        //the source is stat'ed before it is read, so a file changed during the copy is copied again next time 
+        struct stat src_st;
+        if(fstatat(src_fd, names[k], &src_st, 0) == -1){
+            continue;  //removed meanwhile 
+        }
+
+        int trg_dirs[MAX_TARGETS];
+        const char *trg_paths[MAX_TARGETS];
+        int owner[MAX_TARGETS];
+        int errs[MAX_TARGETS];
+        int copy_count = 0;
+        int stored = 0;  //files compressed into the snapshot of a compressed target 
+
+        for(int i = 0; i < target_count; i++){
+            if(work_fd[i] < 0 || filter_excluded(&target_filters[i], names[k])){
+                continue;
+            }
+
+            //snapshots of a compressed target are compressed too and compared by their stored metadata 
+            if(targets[i].compress){
+                if(prev_fd[i] >= 0 && stored_current(prev_fd[i], names[k], &src_st) && linkat(prev_fd[i], names[k], work_fd[i], names[k], 0) == 0){
+                    targets[i].linked++;
+                    continue;
+                }
+                int err = store_compressed(&targets[i], work_fd[i], names[k]);
+                if(err == 0){
+                    targets[i].copied++;
+                    stored = 1;
+                } else{
+                    char msg[2 * PATH_MAX];
+                    snprintf(msg, sizeof(msg), "Compress error on: %s/%s/%s (%s)\n", work_paths[i], work_name[i], names[k], strerror(err));
+                    append_error(err_buf, msg);
+                    targets[i].failed++;
+                    errors++;
+                }
+                continue;
+            }
+
+            if(prev_fd[i] >= 0){
+                struct stat prev_st;
+                if(fstatat(prev_fd[i], names[k], &prev_st, 0) == 0 && prev_st.st_size == src_st.st_size &&
+                   prev_st.st_mtim.tv_sec == src_st.st_mtim.tv_sec && prev_st.st_mtim.tv_nsec == src_st.st_mtim.tv_nsec &&
+                   linkat(prev_fd[i], names[k], work_fd[i], names[k], 0) == 0){
+                    targets[i].linked++;
+                    continue;
+                }
+                //changed, new, or the link failed (e.g. too many links): copy it 
+            }
+            owner[copy_count] = i;
+            trg_paths[copy_count] = work_paths[i];
+            trg_dirs[copy_count++] = work_fd[i];
+        }
+
+        if(copy_count == 0){
+            copied += stored;
+            continue;
+        }
+        bucket_consume(&file_bucket, 1);
+        copy_file(names[k], trg_dirs, trg_paths, copy_count, errs, err_buf, &errors);
+
+        int failed = 0;
+        for(int c = 0; c < copy_count; c++){
+            target_dir *target = &targets[owner[c]];
+            //keep the source mtime so the next snapshot can recognise the file as unchanged 
+            struct timespec times[2] = {{0, UTIME_OMIT}, src_st.st_mtim};
+            if(errs[c] == 0 && utimensat(trg_dirs[c], names[k], times, 0) == -1){
+                errs[c] = errno;
+            }
+            if(errs[c] == 0){
+                target->copied++;
+            } else{
+                target->failed++;
+                failed++;
+            }
+        }
+        if(failed < copy_count || stored){
+            copied++;
+        }
+    }
+    free_name_list(names, count);
+
+    //publish the finished snapshots 
+    int linked = 0;
+    for(int i = 0; i < target_count; i++){
+        linked += targets[i].linked;
+        if(work_fd[i] >= 0 && renameat(snap_fd[i], work_name[i], snap_fd[i], final_name[i]) == -1){
+            char msg[2 * PATH_MAX];
+            snprintf(msg, sizeof(msg), "Cannot publish snapshot: %s/%s (%s)\n", work_paths[i], final_name[i], strerror(errno));
+            append_error(err_buf, msg);
+            targets[i].failed++;
+            errors++;
+        }
+        free(snap_path[i]);
+        if(prev_fd[i] >= 0){
+            close(prev_fd[i]);
+        }
+        if(work_fd[i] >= 0){
+            close(work_fd[i]);
+        }
+        if(snap_fd[i] >= 0){
+            close(snap_fd[i]);
+        }
+    }
+
+    const char *status = errors == 0 ? "SUCCESS" : (copied > 0 || linked > 0 ? "PARTIAL" : "ERROR");
+    printf("EXEC_REPORT_START\n");
+    printf("STATUS: %s\n", status);
+    printf("DETAILS: Snapshot %s: %d files copied, %d linked, %d failed\n", stamp, copied, linked, errors);
+    print_target_reports();
+    if(strlen(err_buf) > 0){
+        printf("ERRORS: %s", err_buf);
+    }
+    printf("EXEC_REPORT_END\n");
+}
+
+
+//running content hash; a word split between two reads waits in tail, so the result depends only on the 
+//content and not on how read() happened to split it 
+typedef struct{
+    unsigned long long hash;
+    unsigned long long length;
+    char tail[8];
+    int tail_len;
+}content_hash;
+
+
+void hash_init(content_hash *state){
+    state->hash = 0x9E3779B97F4A7C15ULL;
+    state->length = 0;
+    state->tail_len = 0;
+}
+
+
+//mix one 8-byte word into the hash 
+static unsigned long long hash_word(unsigned long long hash, const char *bytes){
+    unsigned long long word;
+    memcpy(&word, bytes, 8);
+    hash = (hash ^ word) * 0x100000001B3ULL;
+    return (hash << 31) | (hash >> 33);
+}
+
+
+//mix one buffer into a content hash: the pending tail first, then whole words, and keep the rest for later 
+void hash_update(content_hash *state, const char *buffer, size_t bytes){
+    size_t i = 0;
+    state->length += bytes;
+    if(state->tail_len > 0){
+        while(state->tail_len < 8 && i < bytes){
+            state->tail[state->tail_len++] = buffer[i++];
+        }
+        if(state->tail_len < 8){
+            return;
+        }
+        state->hash = hash_word(state->hash, state->tail);
+        state->tail_len = 0;
+    }
+    for(; i + 8 <= bytes; i += 8){
+        state->hash = hash_word(state->hash, buffer + i);
+    }
+    memcpy(state->tail, buffer + i, bytes - i);
+    state->tail_len = bytes - i;
+}
+
+
+//mix the last bytes one by one and the length into the result 
+unsigned long long hash_final(const content_hash *state){
+    unsigned long long hash = state->hash;
+    for(int i = 0; i < state->tail_len; i++){
+        hash = (hash ^ (unsigned char)state->tail[i]) * 0x100000001B3ULL;
+    }
+    return hash ^ state->length;
+}
+
+
+//hash a whole file with a 64-bit multiply/rotate mix over 8-byte words (returns -1 if it cannot be read)
+int hash_file(int dir, const char *name, unsigned long long *hash_out){
+
+    int fd = openat(dir, name, O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        return -1;
     }
 
-    //read from source and write to target
     char buffer[BUF_SIZE];
+    content_hash hash;
+    hash_init(&hash);
     ssize_t bytes;
-    while((bytes = read(fd_src, buffer, BUF_SIZE)) > 0){
-        if(write(fd_trg, buffer, bytes) != bytes){
-            //handle write error 
-            char msg[256];
-            snprintf(msg, sizeof(msg), "Write error on: %s (%s)\n", trg, strerror(errno));
-            strncat(err_buf, msg, ERR_BUF_SIZE - strlen(err_buf) - 1);
-            err_buf[ERR_BUF_SIZE - 1] = '\0';
-            (*errors)++;
-            break;
+    while((bytes = read(fd, buffer, sizeof(buffer))) != 0){
+        if(bytes < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            close(fd);
+            return -1;
         }
+        bucket_consume(&byte_bucket, bytes);
+        __atomic_add_fetch(&bytes_read, bytes, __ATOMIC_RELAXED);
+        hash_update(&hash, buffer, bytes);
     }
+    close(fd);
 
-    close(fd_src);
-    close(fd_trg);
-    return 1;
+    *hash_out = hash_final(&hash);
+    return 0;
+}
+
+
+//read the next block of a compressed file into raw (returns its raw length, 0 at the end, -1 if it is damaged)
+int read_block(int fd, char *stored, char *raw){
+    int raw_size, stored_size, is_raw;
+    ssize_t bytes = read_full(fd, stored, FSZ_BLOCK_HEADER);
+    if(bytes == 0){
+        return 0;
+    }
+    if(bytes != FSZ_BLOCK_HEADER || fsz_block_info(stored, &raw_size, &stored_size, &is_raw) == -1 ||
+       read_full(fd, stored + FSZ_BLOCK_HEADER, stored_size) != stored_size){
+        errno = EIO;
+        return -1;
+    }
+    bucket_consume(&byte_bucket, FSZ_BLOCK_HEADER + stored_size);
+    __atomic_add_fetch(&bytes_read, FSZ_BLOCK_HEADER + stored_size, __ATOMIC_RELAXED);
+    if(is_raw){
+        memcpy(raw, stored + FSZ_BLOCK_HEADER, raw_size);
+    } else if(fsz_decompress_block(stored + FSZ_BLOCK_HEADER, stored_size, raw, FSZ_BLOCK_SIZE) != raw_size){
+        errno = EIO;
+        return -1;
+    }
+    return raw_size;
 }
 
 
-//perform a full synchronization of all regular files from source to target directory 
-void perform_full_sync(const char *src_dir, const char *trg_dir){
+//hash the original content of a compressed file block by block; content_hash carries a partial word 
+//between updates, so the result equals the hash_file result of the source (returns -1 if it cannot be read or is damaged)
+int hash_compressed(int dir, const char *name, unsigned long long *hash_out){
 
-    DIR *src = opendir(src_dir);
-    if(!src){
-        //report failure to open source directory 
-        printf("EXEC_REPORT_START\nSTATUS: ERROR\nDETAILS: Cannot open source dir %s (%s)\nEXEC_REPORT_END\n", src_dir, strerror(errno));
+    int fd = openat(dir, name, O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        return -1;
+    }
+    char head[FSZ_HEADER_SIZE];
+    fsz_header header;
+    if(read_full(fd, head, sizeof(head)) != FSZ_HEADER_SIZE || fsz_read_header(head, &header) == -1){
+        close(fd);
+        return -1;
+    }
+
+    char stored[FSZ_BOUND(FSZ_BLOCK_SIZE)];
+    char raw[FSZ_BLOCK_SIZE];
+    content_hash hash;
+    hash_init(&hash);
+    int bytes;
+    while((bytes = read_block(fd, stored, raw)) > 0){
+        hash_update(&hash, raw, bytes);
+    }
+    close(fd);
+    if(bytes < 0 || hash.length != header.size){
+        return -1;
+    }
+
+    *hash_out = hash_final(&hash);
+    return 0;
+}
+
+
+//shared state of the verify threads 
+typedef struct{
+    char **names;
+    int count;
+    int deep;
+    int next;  //next name to check, taken atomically 
+    unsigned int *mismatch;  //per name: bit i set when target i differs 
+    int *unreadable;  //per name: the source could not be read 
+}verify_job;
+
+
+//compare one source file with every target: size and mtime, and content hashes in deep mode 
+//a target written before the source was last modified missed a change 
+unsigned int verify_file(verify_job *job, const char *name, int *unreadable){
+
+    struct stat src_st;
+    if(fstatat(src_fd, name, &src_st, 0) == -1){
+        return 0;  //removed meanwhile, the DELETED event takes care of it 
+    }
+
+    unsigned int mask = 0;
+    int hashed = 0;
+    unsigned long long src_hash = 0;
+    for(int i = 0; i < target_count; i++){
+        if(filter_excluded(&target_filters[i], name)){
+            continue;
+        }
+        struct stat trg_st;
+        if(targets[i].fd < 0 || stored_stat(&targets[i], name, &trg_st) == -1 ||
+           trg_st.st_size != src_st.st_size || trg_st.st_mtime < src_st.st_mtime){
+            mask |= 1u << i;
+            continue;
+        }
+        if(!job->deep){
+            continue;
+        }
+
+        if(!hashed){
+            if(hash_file(src_fd, name, &src_hash) == -1){
+                *unreadable = 1;
+                return 0;
+            }
+            hashed = 1;
+        }
+        unsigned long long trg_hash;
+        fsz_header header;
+        int compressed = targets[i].compress && read_stored_header(targets[i].fd, name, &header) == 0;
+        if((compressed ? hash_compressed(targets[i].fd, name, &trg_hash) : hash_file(targets[i].fd, name, &trg_hash)) == -1 || trg_hash != src_hash){
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+}
+
+
+//thread body of a verify run: takes names from the shared index until none is left 
+void *verify_thread(void *arg){
+    verify_job *job = arg;
+    int index;
+    while((index = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->count){
+        bucket_consume(&file_bucket, 1);
+        job->mismatch[index] = verify_file(job, job->names[index], &job->unreadable[index]);
+    }
+    return NULL;
+}
+
+
+//check one slice of the sorted source listing against every target with several threads 
+//FSS_VERIFY_FROM resumes after a name, FSS_VERIFY_SLICE bounds the run; differing files are reported as MISMATCH lines, 
+//and as one UNLISTED count per target once the list is full 
+void perform_verify(int deep){
+
+    char **names = NULL;
+    int total = list_regular_files(src_fd, &names);
+    if(total < 0){
+        printf("EXEC_REPORT_START\nSTATUS: ERROR\nDETAILS: Cannot open source dir %s (%s)\nEXEC_REPORT_END\n", src_path, strerror(src_fd < 0 ? src_errno : errno));
         return;
     }
 
-    struct dirent *entry;
-    int copied = 0, errors = 0;
+    const char *from = getenv("FSS_VERIFY_FROM");
+    const char *slice_env = getenv("FSS_VERIFY_SLICE");
+    int slice = (slice_env && atoi(slice_env) > 0) ? atoi(slice_env) : DEFAULT_VERIFY_SLICE;
+
+    //skip what earlier runs already checked 
+    int first = 0;
+    if(from && from[0] != '\0'){
+        while(first < total && strcmp(names[first], from) <= 0){
+            first++;
+        }
+    }
+    int count = (total - first) < slice ? (total - first) : slice;
+
+    verify_job job;
+    job.names = names + first;
+    job.count = count;
+    job.deep = deep;
+    job.next = 0;
+    job.mismatch = calloc(count + 1, sizeof(unsigned int));
+    job.unreadable = calloc(count + 1, sizeof(int));
+    if(!job.mismatch || !job.unreadable){
+        printf("EXEC_REPORT_START\nSTATUS: ERROR\nDETAILS: Out of memory\nEXEC_REPORT_END\n");
+        free_name_list(names, total);
+        return;
+    }
+
+    int threads = copy_threads < count ? copy_threads : count;
+    pthread_t ids[MAX_COPY_THREADS];
+    int started = 0;
+    for(int t = 0; t < threads; t++){
+        if(pthread_create(&ids[started], NULL, verify_thread, &job) == 0){
+            started++;
+        }
+    }
+    if(started == 0){
+        verify_thread(&job);
+    }
+    for(int t = 0; t < started; t++){
+        pthread_join(ids[t], NULL);
+    }
+
+    //count first: the totals, the progress and the target lines go ahead of the mismatch list, 
+    //so they always fit into the report buffer of the manager 
+    int mismatches = 0, errors = 0;
     char err_buf[ERR_BUF_SIZE] = "";
+    for(int k = 0; k < count; k++){
+        if(job.unreadable[k]){
+            char msg[NAME_MAX + 64];
+            snprintf(msg, sizeof(msg), "Cannot read source: %s\n", job.names[k]);
+            append_error(err_buf, msg);
+            errors++;
+        }
+        for(int i = 0; i < target_count; i++){
+            if(job.mismatch[k] & (1u << i)){
+                targets[i].failed++;
+                mismatches++;
+            } else if(!job.unreadable[k]){
+                targets[i].copied++;
+            }
+        }
+    }
 
-    while((entry = readdir(src)) != NULL){
-        if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0){
-            continue;
+    int more = (first + count < total);
+    printf("EXEC_REPORT_START\n");
+    printf("STATUS: %s\n", errors == 0 ? "SUCCESS" : "PARTIAL");
+    printf("DETAILS: %d files verified%s, %d mismatches\n", count, deep ? " (deep)" : "", mismatches);
+    printf("PROGRESS: %d %d %d %s\n", first + count, total, more, count > 0 ? job.names[count - 1] : (from ? from : ""));
+    print_target_reports();
+
+    //mismatches are listed in listing order up to MISMATCH_BYTES, the rest is only counted per target 
+    int listed_bytes = 0;
+    int unlisted[MAX_TARGETS] = {0};
+    for(int k = 0; k < count; k++){
+        for(int i = 0; i < target_count; i++){
+            if(!(job.mismatch[k] & (1u << i))){
+                continue;
+            }
+            if(listed_bytes < MISMATCH_BYTES){
+                listed_bytes += printf("MISMATCH: %d %s\n", i, job.names[k]);
+            } else{
+                unlisted[i]++;
+            }
+        }
+    }
+    for(int i = 0; i < target_count; i++){
+        if(unlisted[i] > 0){
+            printf("UNLISTED: %d %d\n", i, unlisted[i]);
         }
+    }
+    if(strlen(err_buf) > 0){
+        printf("ERRORS: %s", err_buf);
+    }
+    printf("EXEC_REPORT_END\n");
 
-        char full_src[PATH_MAX], full_trg[PATH_MAX];
-        snprintf(full_src, sizeof(full_src), "%s/%s", src_dir, entry->d_name);
-        snprintf(full_trg, sizeof(full_trg), "%s/%s", trg_dir, entry->d_name);
+    free(job.mismatch);
+    free(job.unreadable);
+    free_name_list(names, total);
+}
 
-        struct stat st;
-        if (stat(full_src, &st) == -1 || !S_ISREG(st.st_mode)){
-            //skip non-regular files 
-            continue;
+
+//write the original content of a target file to dst through a temporary file, with its source mode and mtime; 
+//files of uncompressed targets are copied as they are (returns 0 or the errno of the failure)
+int restore_file(int trg_dir, int dst_dir, const char *name){
+
+    char tmp[TEMP_NAME_LEN];
+    if(temp_name(name, tmp, sizeof(tmp)) == -1){
+        return errno;
+    }
+    int fd_in = openat(trg_dir, name, O_RDONLY | O_CLOEXEC);
+    if(fd_in < 0){
+        return errno;
+    }
+
+    //without a header the file is restored from offset 0 as plain data 
+    struct stat st;
+    char head[FSZ_HEADER_SIZE];
+    fsz_header header;
+    int compressed = (read_full(fd_in, head, sizeof(head)) == FSZ_HEADER_SIZE && fsz_read_header(head, &header) == 0);
+    int fd_out = -1;
+    if(fstat(fd_in, &st) == -1 || (!compressed && lseek(fd_in, 0, SEEK_SET) == -1) ||
+       (fd_out = openat(dst_dir, tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)) < 0){
+        int err = errno;
+        close(fd_in);
+        return err;
+    }
+    if(!compressed){
+        header.size = st.st_size;
+        header.mtime_sec = st.st_mtim.tv_sec;
+        header.mtime_nsec = st.st_mtim.tv_nsec;
+        header.mode = st.st_mode & 07777;
+    }
+
+    char stored[FSZ_BOUND(FSZ_BLOCK_SIZE)];
+    char raw[FSZ_BLOCK_SIZE];
+    unsigned long long total = 0;
+    int err = 0;
+    ssize_t bytes;
+    while((bytes = compressed ? read_block(fd_in, stored, raw) : read_full(fd_in, raw, sizeof(raw))) > 0){
+        if(!compressed){
+            bucket_consume(&byte_bucket, bytes);
+            __atomic_add_fetch(&bytes_read, bytes, __ATOMIC_RELAXED);
         }
-        if (copy_file(full_src, full_trg, err_buf, &errors)) {
-            copied++;
+        if(write_all(fd_out, raw, bytes, total) == -1){
+            err = errno;
+            break;
         }
+        total += bytes;
+    }
+    if(err == 0 && (bytes < 0 || total != header.size)){
+        err = bytes < 0 ? errno : EIO;  //truncated file 
     }
+    if(err == 0 && fchmod(fd_out, header.mode) == -1){
+        err = errno;
+    }
+    if(close(fd_out) == -1 && err == 0){
+        err = errno;
+    }
+    close(fd_in);
 
-    closedir(src);
+    struct timespec times[2] = {{0, UTIME_OMIT}, {header.mtime_sec, header.mtime_nsec}};
+    if(err == 0 && (utimensat(dst_dir, tmp, times, 0) == -1 || renameat(dst_dir, tmp, dst_dir, name) == -1)){
+        err = errno;
+    }
+    if(err != 0){
+        unlinkat(dst_dir, tmp, 0);
+    }
+    return err;
+}
 
-    //determine final status 
-    const char *status;
-    if(errors == 0){
-        status = "SUCCESS";
+
+//restore one file or every file (ALL) of the first target into dst_dir, which is created if needed 
+void perform_restore(const char *dst_dir, const char *filename){
+
+    char err_buf[ERR_BUF_SIZE] = "";
+    int errors = 0;
+    target_dir *target = &targets[0];
+
+    char **names = NULL;
+    int count = 1;
+    if(strcmp(filename, "ALL") == 0){
+        count = list_regular_files(target->fd, &names);
+        if(count < 0){
+            printf("EXEC_REPORT_START\nSTATUS: ERROR\nDETAILS: Cannot open target dir %s (%s)\nEXEC_REPORT_END\n", target->dir, strerror(target->fd < 0 ? target->fd_errno : errno));
+            return;
+        }
     }
-    else if(copied > 0){
-        status = "PARTIAL";
+    int dst_fd = -1;
+    if((mkdir(dst_dir, 0755) == -1 && errno != EEXIST) || (dst_fd = open_dir(AT_FDCWD, dst_dir)) < 0){
+        printf("EXEC_REPORT_START\nSTATUS: ERROR\nDETAILS: Cannot create restore dir %s (%s)\nEXEC_REPORT_END\n", dst_dir, strerror(errno));
+        if(names){
+            free_name_list(names, count);
+        }
+        return;
     }
-    else{
-        status = "ERROR";
+
+    for(int k = 0; k < count; k++){
+        const char *name = names ? names[k] : filename;
+        if(name[0] == '.' && strstr(name, ".fss_part")){
+            continue;  //unfinished temporary file 
+        }
+        bucket_consume(&file_bucket, 1);
+        files_done++;
+        int err = target->fd < 0 ? target->fd_errno : restore_file(target->fd, dst_fd, name);
+        if(err == 0){
+            target->copied++;
+        } else{
+            char msg[PATH_MAX + 64];
+            snprintf(msg, sizeof(msg), "Restore error on: %s (%s)\n", name, strerror(err));
+            append_error(err_buf, msg);
+            target->failed++;
+            errors++;
+        }
+    }
+    if(names){
+        free_name_list(names, count);
     }
+    close(dst_fd);
 
-    //print final EXEC_REPORT
+    const char *status = errors == 0 ? "SUCCESS" : (target->copied > 0 ? "PARTIAL" : "ERROR");
     printf("EXEC_REPORT_START\n");
     printf("STATUS: %s\n", status);
-    printf("DETAILS: %d files copied, %d failed\n", copied, errors);
+    printf("DETAILS: %d files restored from %s, %d failed\n", target->copied, target->dir, errors);
+    print_target_reports();
     if(strlen(err_buf) > 0){
         printf("ERRORS: %s", err_buf);
     }
-        
     printf("EXEC_REPORT_END\n");
 }
 
 
+//split the colon separated target list and mark the targets named by FSS_MIRROR_TARGETS (all of them if unset)
+int parse_targets(const char *list, int mirror){
+
+    static char buffer[MAX_TARGETS * PATH_MAX];  //the target entries point into this buffer
+    strncpy(buffer, list, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+
+    char *saveptr;
+    char *dir = strtok_r(buffer, ":", &saveptr);
+    while(dir && target_count < MAX_TARGETS){
+        target_dir *target = &targets[target_count++];
+        memset(target, 0, sizeof(*target));
+        target->dir = dir;
+        target->fd = open_dir(AT_FDCWD, dir);
+        target->fd_errno = errno;
+        target->store_fd = -1;
+        dir = strtok_r(NULL, ":", &saveptr);
+    }
+
+    for(int i = 0; i < target_count; i++){
+        char name[32];
+        snprintf(name, sizeof(name), "FSS_FILTER_%d", i);
+        filter_init(&target_filters[i]);
+        const char *spec = getenv(name);
+        if(spec){
+            filter_parse(&target_filters[i], spec);
+        }
+        snprintf(name, sizeof(name), "FSS_DEDUP_%d", i);
+        const char *dedup = getenv(name);
+        if(dedup){
+            targets[i].dedup = strcmp(dedup, "link") == 0 ? DEDUP_LINK : DEDUP_CLONE;
+        }
+        snprintf(name, sizeof(name), "FSS_DEDUP_STORE_%d", i);
+        targets[i].store_dir = getenv(name);
+        snprintf(name, sizeof(name), "FSS_COMPRESS_%d", i);
+        targets[i].compress = (getenv(name) != NULL);
+    }
+
+    const char *mask = getenv("FSS_MIRROR_TARGETS");
+    for(int i = 0; i < target_count; i++){
+        targets[i].mirror = mirror && !mask;
+    }
+    if(mirror && mask){
+        char mask_buf[256];
+        strncpy(mask_buf, mask, sizeof(mask_buf) - 1);
+        mask_buf[sizeof(mask_buf) - 1] = '\0';
+        char *index = strtok_r(mask_buf, ",", &saveptr);
+        while(index){
+            int i = atoi(index);
+            if(i >= 0 && i < target_count){
+                targets[i].mirror = 1;
+            }
+            index = strtok_r(NULL, ",", &saveptr);
+        }
+    }
+    return target_count;
+}
+
+
 int main(int argc, char *argv[]){
     if(argc != 5){
-        fprintf(stderr, "Usage: %s <src_dir> <trg_dir> <filename|ALL> <operation>\n", argv[0]);
+        fprintf(stderr, "Usage: %s <src_dir> <trg_dir[:trg_dir...]> <filename|ALL|list_file|-> <operation>\n", argv[0]);
         return 1;
     }
 
     const char *src_dir = argv[1];
-    const char *trg_dir = argv[2];
     const char *filename = argv[3];
     const char *operation = argv[4];
 
-    //handle FULL operation 
-    if(strcmp(operation, "FULL") == 0 && strcmp(filename, "ALL") == 0){
-        perform_full_sync(src_dir, trg_dir);
-    } else if(strcmp(operation, "ADDED") == 0 || strcmp(operation, "MODIFIED") == 0){ //handle file addition or modification 
+    start_us = monotonic_us();
+    init_throttling();
+
+    //the source is opened once; a missing one is reported by the operation that needs it 
+    src_path = src_dir;
+    src_fd = open_dir(AT_FDCWD, src_dir);
+    src_errno = errno;
+
+    if(parse_targets(argv[2], strcmp(operation, "MIRROR") == 0) == 0){
+        printf("EXEC_REPORT_START\nSTATUS: ERROR\nDETAILS: No target directory given\nEXEC_REPORT_END\n");
+        return 1;
+    }
 
-        char full_src[PATH_MAX], full_trg[PATH_MAX];
-        snprintf(full_src, sizeof(full_src), "%s/%s", src_dir, filename);
-        snprintf(full_trg, sizeof(full_trg), "%s/%s", trg_dir, filename);
+    //handle FULL and MIRROR operations 
+    if((strcmp(operation, "FULL") == 0 || strcmp(operation, "MIRROR") == 0) && strcmp(filename, "ALL") == 0){
+        perform_full_sync();
+    } else if((strcmp(operation, "VERIFY") == 0 || strcmp(operation, "VERIFY_DEEP") == 0) && strcmp(filename, "ALL") == 0){ //handle a verify slice 
+        perform_verify(strcmp(operation, "VERIFY_DEEP") == 0);
+    } else if(strcmp(operation, "SNAPSHOT") == 0 && strcmp(filename, "ALL") == 0){ //handle an incremental snapshot 
+        perform_snapshot();
+    } else if(strcmp(operation, "RESTORE") == 0){ //handle a restore from the first target into src_dir 
+        perform_restore(src_dir, filename);
+    } else if(strcmp(operation, "BATCH") == 0){ //handle a list of file operations 
+        perform_batch(filename);
+    } else if(strcmp(operation, "ADDED") == 0 || strcmp(operation, "MODIFIED") == 0){ //handle file addition or modification 
 
         char err_buf[ERR_BUF_SIZE] = "";
         int errors = 0;
 
-        if(copy_file(full_src, full_trg, err_buf, &errors)){
-            printf("STATUS: SUCCESS\n");
+        if(copy_to_targets(filename, err_buf, &errors) < target_count){
+            printf("STATUS: %s\n", errors == 0 ? "SUCCESS" : "PARTIAL");
             printf("DETAILS: File: %s %s\n", filename, strcmp(operation, "ADDED") == 0 ? "added" : "modified");
         } else{
             printf("STATUS: ERROR\n");
             printf("DETAILS: File: %s  Failed to %s file: %s\n", filename, operation, filename);
-            if(strlen(err_buf) > 0){
-                printf("ERRORS: %s\n", err_buf);
-            }
+        }
+        print_target_reports();
+        if(strlen(err_buf) > 0){
+            printf("ERRORS: %s\n", err_buf);
         }
     } else if(strcmp(operation, "DELETED") == 0){ //handle file deletion 
-        char full_trg[PATH_MAX];
-        snprintf(full_trg, sizeof(full_trg), "%s/%s", trg_dir, filename);
+        char err_buf[ERR_BUF_SIZE] = "";
+        int failed = delete_from_targets(filename, err_buf);
 
-        if(unlink(full_trg) == 0){
+        if(failed == 0){
             printf("STATUS: SUCCESS\n");
             printf("DETAILS: File: %s deleted\n", filename);
         } else{
-            printf("STATUS: ERROR\n");
-            printf("DETAILS: File: %s  Failed to delete file: %s (%s)\n", filename, filename, strerror(errno));
+            printf("STATUS: %s\n", failed < target_count ? "PARTIAL" : "ERROR");
+            printf("DETAILS: File: %s  Failed to delete file: %s\n", filename, filename);
+        }
+        print_target_reports();
+        if(strlen(err_buf) > 0){
+            printf("ERRORS: %s\n", err_buf);
         }
     } else{ //handle unsupported operation 
         printf("STATUS: ERROR\n");
@@ -171,4 +2313,4 @@ int main(int argc, char *argv[]){
     printf("EXEC_REPORT_END\n");
 
     return 0;
-}
\ No newline at end of file
+}